@@ -9,15 +9,24 @@
  */
 
 #include "adjacencyhandler.h"
+#include "graphfile.h"
 
 using namespace std;
 
-AdjacencyHandler::AdjacencyHandler(const string file, size_t size)
+AdjacencyHandler::AdjacencyHandler(const string file, size_t size, WindowArena* a)
 {
-	init(file, size);
-	string degName = getDegName(file.c_str());
-	deg = new DegreeHandler(degName, bufferSize);
-	own = true;
+	init(file, size, a);
+	string degName = getDegFile(file.c_str());
+	if (arena != NULL)
+	{
+		deg = arena->getDegrees(degName, bufferSize);
+		own = false;
+	}
+	else
+	{
+		deg = new DegreeHandler(degName, bufferSize);
+		own = true;
+	}
 	graphSize = deg->getGraphSize();
 }
 
@@ -25,7 +34,7 @@ AdjacencyHandler::AdjacencyHandler(const std::string file,
                                    DegreeHandler* dgr, 
                                    size_t size)
 {
-	init(file, size);
+	init(file, size, NULL);
 	if (dgr != NULL)
 	{
 		deg = dgr;
@@ -33,38 +42,68 @@ AdjacencyHandler::AdjacencyHandler(const std::string file,
 	}
 	else
 	{
-		string degName = getDegName(file.c_str());
+		string degName = getDegFile(file.c_str());
 		deg = new DegreeHandler(degName, bufferSize);
 		own = true;
 	}
 	graphSize = deg->getGraphSize();
 }
 
-void AdjacencyHandler::init(const std::string file, size_t size)
+void AdjacencyHandler::init(const std::string file, size_t size, WindowArena* a)
 {
+	arena = a;
 	bufferSize = size;
-	buffer = new vx[bufferSize];
 
 	const char* name = file.c_str();
 
-	string adjName = getAdjName(name);
-	fd = fopen(adjName.c_str(), READ_FLAG);
+	adjName = getAdjFile(name);
+	adjStart = getAdjStart(name);
+	compressed = InputStream::isCompressed(adjName);
+	stream = NULL;
+	splitter = NULL;
+	arrival = NULL;
+	if (arena != NULL)
+	{
+		buffer = arena->get<vx>(ARENA_BUFFER, bufferSize);
+		fd = arena->getFile(ARENA_ADJ, adjName);
+	}
+	else
+	{
+		buffer = new vx[bufferSize];
+		fd = fopen(adjName.c_str(), READ_FLAG);
+	}
 }
 
 AdjacencyHandler::~AdjacencyHandler()
 {
-	delete[] buffer;
 	if (own)
 	{
 		delete deg;
 	}
-	fclose(fd);
+	if (arena == NULL)
+	{
+		delete[] buffer;
+		fclose(fd);
+	}
 }
 
 void AdjacencyHandler::processAdjacency(unsigned long long low, 
                                         unsigned long long high)
 {
-	fseek64(fd, low*sizeof(vx), SEEK_SET);
+	if (compressed)
+	{
+		// the stream reads ahead, so the whole file must have arrived
+		if (arrival != NULL)
+		{
+			arrival->waitFor(0, MAX_EDGES);
+		}
+		stream = new InputStream(adjName);
+		stream->skip(low*sizeof(vx));
+	}
+	else
+	{
+		fseek64(fd, adjStart + low*sizeof(vx), SEEK_SET);
+	}
 
 	vx u = 0;
 	unsigned long long off = 0;
@@ -77,17 +116,21 @@ void AdjacencyHandler::processAdjacency(unsigned long long low,
 
 	vx vertex = u - 1;
 	vx processed = deg->getDegree(vertex) + (vx) (low - off);
-	unsigned long long rem = high - low;
+	unsigned long long next = low; // offset of the next edge to handle
+	unsigned long long read = low; // offset after the edges read
 	unsigned long long buffSize = bufferSize;
 	size_t size;
 
+	rangeNext = low;
+	rangeHigh = high;
 	overallSetUp();
 	phaseSetUp();
-	while (0 < (size = fread(buffer, sizeof(vx), min(rem, buffSize), fd)))
+	while (next < high && 0 < (size = readBuffer(read, min(high - read, buffSize))))
 	{
 		size_t total = 0;
+		read += size;
 
-		while (total < size)
+		while (total < size && next < high)
 		{
 			vx degree = deg->getDegree(vertex);
 			vx remaining = degree - processed;
@@ -106,26 +149,51 @@ void AdjacencyHandler::processAdjacency(unsigned long long low,
 
 			vx i;
 
-			for (i = 0; i < remaining; ++i)
+			for (i = 0; i < remaining && next < high; ++i, ++next)
 			{
 				vx to = buffer[total + i];
 				while (!handleEdge(from, to, degree))
 				{
+					// the edges not yet loaded may go to an idle thread
+					if (splitter != NULL)
+					{
+						high = splitter->split(next, high);
+					}
+					rangeNext = next;
+					rangeHigh = high;
 					processPhase();
 					phaseSetUp();
 				}
 
 			}
 
-			total += remaining;
+			total += i;
 
 		}
-
-		rem -= (unsigned long long) size;
 	}
 
 
+	if (stream != NULL)
+	{
+		delete stream;
+		stream = NULL;
+	}
+
+	rangeHigh = high;
 	processPhase();
 	overallTearDown();
 }
 
+size_t AdjacencyHandler::readBuffer(unsigned long long offset, size_t count)
+{
+	if (arrival != NULL)
+	{
+		arrival->waitFor(adjStart + offset*sizeof(vx), adjStart + (offset + count)*sizeof(vx));
+	}
+	if (stream != NULL)
+	{
+		return stream->read(buffer, count*sizeof(vx))/sizeof(vx);
+	}
+	return fread(buffer, sizeof(vx), count, fd);
+}
+
@@ -13,28 +13,57 @@
 #include "util.h"
 #include "degreehandler.h"
 #include "parserutil.h"
+#include "inputstream.h"
+#include "arena.h"
+#include "arrival.h"
+
+// hands the tail of a range of edges being processed to another thread
+
+class RangeSplitter {
+	public:
+		virtual ~RangeSplitter() {}
+		// called between phases, with the offset of the next edge to handle;
+		// returns the new (lower) end of the range, giving the rest away
+		virtual unsigned long long split(unsigned long long next, 
+		                                 unsigned long long high) = 0;
+};
 
 // class that transparently takes care of going through adjacency file once
 
 class AdjacencyHandler {
 	public:
-		// have 2 of bufferSize*sizeof(vx) (one for buffer, one for DegreeHandler)
-		AdjacencyHandler(const std::string file, size_t bufferSize = DEFAULT_BUF);
+		// have 2 of bufferSize*sizeof(vx) (one for buffer, one for DegreeHandler),
+		// kept in the arena if one is given
+		AdjacencyHandler(const std::string file, size_t bufferSize = DEFAULT_BUF, 
+		                 WindowArena* arena = NULL);
 		AdjacencyHandler(const std::string file, DegreeHandler* deg, 
 				             size_t bufferSize = DEFAULT_BUF);
 		virtual ~AdjacencyHandler();
 		void processAdjacency(unsigned long long low, unsigned long long high);
+		void setSplitter(RangeSplitter* s) { splitter = s; }
+		// the adjacency file is still arriving, and reads wait for their part
+		void setArrival(FileArrival* a) { arrival = a; }
 
 	protected:
 		DegreeHandler* deg;
 		FILE* fd;
+		unsigned long long adjStart; // byte offset of the targets in fd
+		std::string adjName;
+		bool compressed; // read through an InputStream instead of fd
 		size_t graphSize;
+		unsigned long long rangeNext; // next edge to handle, at each phase set up
+		unsigned long long rangeHigh; // end of the range, after any splits
+		WindowArena* arena;
+		FileArrival* arrival;
 	private:
 		size_t bufferSize;
 		vx* buffer;
+		InputStream* stream;
+		RangeSplitter* splitter;
 
 		bool own;
-		void init(const std::string file, size_t bufferSize);
+		void init(const std::string file, size_t bufferSize, WindowArena* arena);
+		size_t readBuffer(unsigned long long offset, size_t count);
 
 
 		virtual void overallSetUp() = 0;
@@ -0,0 +1,108 @@
+/*
+ * PDTL: Parallel and Distributed Triangle Listing for Massive Graphs
+ * Ilias Giechaskiel, George Panagopoulos, Eiko Yoneki
+ * 44th International Conference on Parallel Processing (ICPP), Beijing 2015
+ * 
+ * DOI: 10.1109/ICPP.2015.46
+ * 
+ * https://github.com/giech/pdtl
+ */
+
+#include "arena.h"
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+using namespace std;
+
+#define HUGE_PAGE (2 << 20)
+
+void releasePages(void* block, size_t keep, size_t size)
+{
+	size_t page = (size_t) sysconf(_SC_PAGESIZE);
+	char* first = (char*) (((uintptr_t) block + keep + page - 1)/page*page);
+	char* last = (char*) (((uintptr_t) block + size)/page*page);
+	if (first < last)
+	{
+		madvise(first, last - first, MADV_DONTNEED);
+	}
+}
+
+WindowArena::WindowArena()
+{
+	const char* pages = getenv("PDTL_HUGEPAGES");
+	huge = pages != NULL && atoi(pages) != 0;
+	unsigned i;
+	for (i = 0; i < ARENA_SLOTS; ++i)
+	{
+		memory[i] = NULL;
+		sizes[i] = 0;
+	}
+	for (i = 0; i < ARENA_FILES; ++i)
+	{
+		files[i] = NULL;
+	}
+	degrees = NULL;
+}
+
+WindowArena::~WindowArena()
+{
+	unsigned i;
+	for (i = 0; i < ARENA_SLOTS; ++i)
+	{
+		if (memory[i] != NULL)
+			munmap(memory[i], sizes[i]);
+	}
+	for (i = 0; i < ARENA_FILES; ++i)
+	{
+		if (files[i] != NULL)
+			fclose(files[i]);
+	}
+	delete degrees;
+}
+
+void* WindowArena::getBytes(ArenaSlot slot, size_t bytes)
+{
+	if (bytes <= sizes[slot] && memory[slot] != NULL)
+		return memory[slot];
+
+	if (memory[slot] != NULL)
+		munmap(memory[slot], sizes[slot]);
+
+	size_t size = max(bytes, (size_t) 1);
+	if (huge)
+		size = (size + HUGE_PAGE - 1)/HUGE_PAGE*HUGE_PAGE;
+	void* data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (data == MAP_FAILED)
+	{
+		cerr << "Error: could not allocate " << size << " bytes" << endl;
+		exit(1);
+	}
+	if (huge)
+		madvise(data, size, MADV_HUGEPAGE);
+	memory[slot] = data;
+	sizes[slot] = size;
+	return data;
+}
+
+FILE* WindowArena::getFile(ArenaFile slot, const string& name)
+{
+	if (files[slot] != NULL && names[slot] == name)
+		return files[slot];
+	if (files[slot] != NULL)
+		fclose(files[slot]);
+	files[slot] = fopen(name.c_str(), READ_FLAG);
+	names[slot] = name;
+	return files[slot];
+}
+
+DegreeHandler* WindowArena::getDegrees(const string& name, size_t bufferSize)
+{
+	if (degrees == NULL || degreeName != name)
+	{
+		delete degrees;
+		degrees = new DegreeHandler(name, bufferSize);
+		degreeName = name;
+	}
+	return degrees;
+}
@@ -0,0 +1,65 @@
+/*
+ * PDTL: Parallel and Distributed Triangle Listing for Massive Graphs
+ * Ilias Giechaskiel, George Panagopoulos, Eiko Yoneki
+ * 44th International Conference on Parallel Processing (ICPP), Beijing 2015
+ * 
+ * DOI: 10.1109/ICPP.2015.46
+ * 
+ * https://github.com/giech/pdtl
+ */
+
+#pragma once
+
+#include "util.h"
+#include "degreehandler.h"
+
+// Memory and files of a thread that outlive the handlers it runs one after
+// the other. Each slot keeps the largest block asked of it so far, so that a
+// handler of no more memory than the last reuses pages that are already
+// mapped. With PDTL_HUGEPAGES set, blocks are backed by transparent huge pages.
+
+// gives the pages of bytes [keep, size) of a block back to the system, to
+// read as zeros when touched again, while the block stays allocated
+void releasePages(void* block, size_t keep, size_t size);
+
+enum ArenaSlot {
+	ARENA_NMEM,
+	ARENA_NMEMPLUS,
+	ARENA_INTERSECTION,
+	ARENA_VXBUFFER,
+	ARENA_BUFFER,
+	ARENA_INDS,
+	ARENA_EDGES,
+	ARENA_SLOTS
+};
+
+enum ArenaFile {
+	ARENA_ADJ,
+	ARENA_SCAN,
+	ARENA_FILES
+};
+
+class WindowArena {
+	public:
+		WindowArena();
+		~WindowArena();
+		// at least count elements, not initialised
+		template<class T> T* get(ArenaSlot slot, size_t count)
+		{
+			return static_cast<T*> (getBytes(slot, count*sizeof(T)));
+		}
+		// the file opened for reading, kept open while the name stays the same
+		FILE* getFile(ArenaFile slot, const std::string& name);
+		DegreeHandler* getDegrees(const std::string& name, size_t bufferSize);
+
+	private:
+		bool huge;
+		void* memory[ARENA_SLOTS];
+		size_t sizes[ARENA_SLOTS];
+		FILE* files[ARENA_FILES];
+		std::string names[ARENA_FILES];
+		DegreeHandler* degrees;
+		std::string degreeName;
+
+		void* getBytes(ArenaSlot slot, size_t bytes);
+};
@@ -0,0 +1,84 @@
+/*
+ * PDTL: Parallel and Distributed Triangle Listing for Massive Graphs
+ * Ilias Giechaskiel, George Panagopoulos, Eiko Yoneki
+ * 44th International Conference on Parallel Processing (ICPP), Beijing 2015
+ * 
+ * DOI: 10.1109/ICPP.2015.46
+ * 
+ * https://github.com/giech/pdtl
+ */
+
+#include "arrival.h"
+
+using namespace std;
+
+#define ARRIVAL_READAHEAD (64 << 10)
+
+FileArrival::FileArrival(const vector<FileSegment>& o)
+: order(o), received(0), started(false), done(false), complete(false)
+{}
+
+void FileArrival::start()
+{
+	lock_guard<mutex> lock(mtx);
+	started = true;
+	arrived.notify_all();
+}
+
+void FileArrival::advance(unsigned long long bytes)
+{
+	lock_guard<mutex> lock(mtx);
+	received += bytes;
+	arrived.notify_all();
+}
+
+void FileArrival::finish(bool c)
+{
+	lock_guard<mutex> lock(mtx);
+	done = true;
+	complete = c;
+	arrived.notify_all();
+}
+
+bool FileArrival::waitForStart()
+{
+	unique_lock<mutex> lock(mtx);
+	while (!started && !done)
+	{
+		arrived.wait(lock);
+	}
+	return started;
+}
+
+bool FileArrival::waitFor(unsigned long long begin, unsigned long long end)
+{
+	// stdio refills its buffer with whole blocks, past the bytes asked for
+	end = end > MAX_EDGES - ARRIVAL_READAHEAD ? MAX_EDGES : end + ARRIVAL_READAHEAD;
+
+	// how far into the stream the last of the bytes is
+	unsigned long long needed = 0, position = 0;
+	size_t i;
+	for (i = 0; i < order.size(); ++i)
+	{
+		unsigned long long first = max(begin, order[i].offset);
+		unsigned long long last = min(end, order[i].offset + order[i].length);
+		if (first < last)
+		{
+			needed = max(needed, position + last - order[i].offset);
+		}
+		position += order[i].length;
+	}
+
+	unique_lock<mutex> lock(mtx);
+	while (received < needed && !done)
+	{
+		arrived.wait(lock);
+	}
+	return received >= needed;
+}
+
+bool FileArrival::isComplete()
+{
+	lock_guard<mutex> lock(mtx);
+	return done && complete;
+}
@@ -0,0 +1,53 @@
+/*
+ * PDTL: Parallel and Distributed Triangle Listing for Massive Graphs
+ * Ilias Giechaskiel, George Panagopoulos, Eiko Yoneki
+ * 44th International Conference on Parallel Processing (ICPP), Beijing 2015
+ * 
+ * DOI: 10.1109/ICPP.2015.46
+ * 
+ * https://github.com/giech/pdtl
+ */
+
+#pragma once
+
+#include "util.h"
+
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+
+// A part of a file, in bytes
+struct FileSegment {
+	unsigned long long offset;
+	unsigned long long length;
+};
+
+// Tracks how much of a file has arrived while it is received, its segments
+// in a given order, so that readers can follow behind the receiver instead
+// of waiting for the whole file.
+
+class FileArrival {
+	public:
+		FileArrival(const std::vector<FileSegment>& order);
+		// the receiver has created the file at its full size, and received the
+		// first segment, which holds the header of the file
+		void start();
+		// the next bytes, in the order of the segments, have arrived
+		void advance(unsigned long long bytes);
+		void finish(bool complete);
+		// false if the transfer failed before the first segment was in
+		bool waitForStart();
+		// blocks until bytes [begin, end) of the file have arrived, and returns
+		// false if the transfer failed first
+		bool waitFor(unsigned long long begin, unsigned long long end);
+		bool isComplete();
+
+	private:
+		std::vector<FileSegment> order;
+		unsigned long long received; // bytes, in the order of the segments
+		bool started;
+		bool done;
+		bool complete;
+		std::mutex mtx;
+		std::condition_variable arrived;
+};
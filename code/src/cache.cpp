@@ -0,0 +1,227 @@
+/*
+ * PDTL: Parallel and Distributed Triangle Listing for Massive Graphs
+ * Ilias Giechaskiel, George Panagopoulos, Eiko Yoneki
+ * 44th International Conference on Parallel Processing (ICPP), Beijing 2015
+ * 
+ * DOI: 10.1109/ICPP.2015.46
+ * 
+ * https://github.com/giech/pdtl
+ */
+
+#include "cache.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <cerrno>
+#include <map>
+#include <vector>
+#include <dirent.h>
+#include <unistd.h>
+#include <utime.h>
+#include <sys/stat.h>
+
+using namespace std;
+
+#define HASH_PRIME 0x100000001B3ULL
+#define HASH_SEED 0xCBF29CE484222325ULL
+#define KEY_DIGITS 16
+
+// FNV-1a over 64-bit words, which keeps up with reading the file
+static unsigned long long hashFile(const string& name, unsigned long long h)
+{
+	FILE* fd = fopen(name.c_str(), READ_FLAG);
+	if (fd == NULL)
+	{
+		cerr << "Could not open " << name << endl;
+		exit(1);
+	}
+
+	vector<unsigned long long> buf(DEFAULT_BUF*sizeof(vx)/sizeof(unsigned long long));
+	size_t got;
+	while ((got = fread(&buf[0], 1, buf.size()*sizeof(unsigned long long), fd)) > 0)
+	{
+		size_t words = got/sizeof(unsigned long long);
+		for (size_t i = 0; i < words; ++i)
+		{
+			h = (h ^ buf[i])*HASH_PRIME;
+		}
+		// the tail of the file, byte by byte
+		const unsigned char* tail = (const unsigned char*) &buf[words];
+		for (size_t i = 0; i < got % sizeof(unsigned long long); ++i)
+		{
+			h = (h ^ tail[i])*HASH_PRIME;
+		}
+	}
+	fclose(fd);
+	return h;
+}
+
+static unsigned long long modified(const struct stat& s)
+{
+	return (unsigned long long) s.st_mtim.tv_sec*1000000000ULL + s.st_mtim.tv_nsec;
+}
+
+unsigned long long graphKey(const char* base, const string& degName, const string& adjName)
+{
+	struct stat deg, adj;
+	if (stat(degName.c_str(), &deg) < 0 || stat(adjName.c_str(), &adj) < 0)
+	{
+		cerr << "Could not find the files of " << base << endl;
+		exit(1);
+	}
+
+	// base.key holds the sizes and modification times the key was computed for
+	string keyName = getKeyName(base);
+	unsigned long long degSize, degTime, adjSize, adjTime, key;
+	ifstream in(keyName);
+	if (in >> degSize >> degTime >> adjSize >> adjTime >> hex >> key &&
+	    degSize == (unsigned long long) deg.st_size && degTime == modified(deg) &&
+	    adjSize == (unsigned long long) adj.st_size && adjTime == modified(adj))
+	{
+		return key;
+	}
+	in.close();
+
+	key = hashFile(degName, HASH_SEED ^ deg.st_size);
+	if (adjName != degName) // a container is both files
+	{
+		key = hashFile(adjName, key ^ adj.st_size);
+	}
+	key = key ? key : 1; // 0 means no key
+
+	ofstream out(keyName);
+	out << deg.st_size << " " << modified(deg) << " " 
+	    << adj.st_size << " " << modified(adj) << " " << hex << key << endl;
+	return key;
+}
+
+GraphCache::GraphCache()
+{
+	const char* d = getenv("PDTL_CACHE");
+	if (d != NULL)
+	{
+		dir = string(d);
+	}
+	const char* l = getenv("PDTL_CACHE_MB");
+	limit = (unsigned long long) (l != NULL ? atoll(l) : CACHE_DEFAULT_MB) << 20;
+
+	if (enabled())
+	{
+		mkdir(dir.c_str(), 0755);
+		cout << "Caching up to " << (limit >> 20) << "MB of graphs in " << dir << endl;
+	}
+}
+
+static string keyString(unsigned long long key)
+{
+	char s[KEY_DIGITS + 1];
+	snprintf(s, sizeof(s), "%016llx", key);
+	return string(s);
+}
+
+string GraphCache::getBase(unsigned long long key) const
+{
+	return dir + "/" + keyString(key);
+}
+
+string GraphCache::getPending(unsigned long long key, int number) const
+{
+	return getBase(key) + ".pending-" + to_string(number);
+}
+
+bool GraphCache::lookup(unsigned long long key)
+{
+	lock_guard<mutex> lock(mtx);
+	string base = getBase(key);
+	string deg = getDegName(base.c_str());
+	string adj = getAdjName(base.c_str());
+
+	// the degrees are renamed into place last
+	if (access(deg.c_str(), R_OK) != 0 || access(adj.c_str(), R_OK) != 0)
+	{
+		return false;
+	}
+	utime(deg.c_str(), NULL);
+	utime(adj.c_str(), NULL);
+	++users[keyString(key)];
+	return true;
+}
+
+bool GraphCache::insert(unsigned long long key, const string& pending)
+{
+	lock_guard<mutex> lock(mtx);
+	string base = getBase(key);
+	if (rename(getAdjName(pending.c_str()).c_str(), getAdjName(base.c_str()).c_str()) < 0 ||
+	    rename(getDegName(pending.c_str()).c_str(), getDegName(base.c_str()).c_str()) < 0)
+	{
+		cerr << strerror(errno) << ": Error caching " << base << endl;
+		return false;
+	}
+	++users[keyString(key)];
+	evict();
+	return true;
+}
+
+void GraphCache::release(unsigned long long key)
+{
+	lock_guard<mutex> lock(mtx);
+	string k = keyString(key);
+	if (users.count(k) > 0 && --users[k] == 0)
+	{
+		users.erase(k);
+	}
+}
+
+void GraphCache::evict()
+{
+	DIR* d = opendir(dir.c_str());
+	if (d == NULL)
+	{
+		return;
+	}
+
+	// sizes and last use of the graphs, by key
+	map<string, pair<unsigned long long, unsigned long long> > graphs;
+	struct dirent* entry;
+	while ((entry = readdir(d)) != NULL)
+	{
+		string name(entry->d_name);
+		string ext = name.size() == KEY_DIGITS + 4 ? name.substr(KEY_DIGITS) : "";
+		if (ext != getDegName("") && ext != getAdjName(""))
+		{
+			continue; // pending files, and anything else
+		}
+		struct stat s;
+		if (stat((dir + "/" + name).c_str(), &s) < 0)
+		{
+			continue;
+		}
+		pair<unsigned long long, unsigned long long>& g = graphs[name.substr(0, KEY_DIGITS)];
+		g.first += s.st_size;
+		g.second = max(g.second, modified(s));
+	}
+	closedir(d);
+
+	unsigned long long total = 0;
+	vector<pair<unsigned long long, string> > byUse;
+	for (map<string, pair<unsigned long long, unsigned long long> >::iterator it = graphs.begin(); 
+	     it != graphs.end(); ++it)
+	{
+		total += it->second.first;
+		if (users.count(it->first) == 0)
+		{
+			byUse.push_back(make_pair(it->second.second, it->first));
+		}
+	}
+	sort(byUse.begin(), byUse.end());
+
+	for (size_t i = 0; i < byUse.size() && total > limit; ++i)
+	{
+		string base = dir + "/" + byUse[i].second;
+		total -= graphs[byUse[i].second].first;
+		remove(getDegName(base.c_str()).c_str());
+		remove(getAdjName(base.c_str()).c_str());
+		cout << "Evicted " << base << " from the cache" << endl;
+	}
+}
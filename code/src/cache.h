@@ -0,0 +1,56 @@
+/*
+ * PDTL: Parallel and Distributed Triangle Listing for Massive Graphs
+ * Ilias Giechaskiel, George Panagopoulos, Eiko Yoneki
+ * 44th International Conference on Parallel Processing (ICPP), Beijing 2015
+ * 
+ * DOI: 10.1109/ICPP.2015.46
+ * 
+ * https://github.com/giech/pdtl
+ */
+
+#pragma once
+
+#include "util.h"
+
+#include <string>
+#include <map>
+#include <mutex>
+
+#define CACHE_DEFAULT_MB 4096
+
+// Content key of a graph, a hash of its degree and adjacency files. The key is
+// remembered in base.key, and only recomputed when the size or modification
+// time of either file changes.
+unsigned long long graphKey(const char* base, 
+                            const std::string& degName, 
+                            const std::string& adjName);
+
+// Graphs received by a client, kept on disk under their content key. The cache
+// lives in the directory named by PDTL_CACHE and holds up to PDTL_CACHE_MB
+// megabytes, dropping the least recently used graphs first, but never one a
+// job is using. Graphs are received under a pending name and renamed into
+// place once complete, so a cached graph is never partial.
+
+class GraphCache {
+	public:
+		GraphCache();
+		inline bool enabled() const { return !dir.empty(); }
+		// base name of the cached graph with the given key
+		std::string getBase(unsigned long long key) const;
+		// base name to receive the graph of a connection under
+		std::string getPending(unsigned long long key, int number) const;
+		// true if the graph is cached, marking it as just used, and in use
+		bool lookup(unsigned long long key);
+		// moves a received graph into the cache, in use, and evicts others
+		// past the limit
+		bool insert(unsigned long long key, const std::string& pending);
+		// a job has finished with the graph
+		void release(unsigned long long key);
+
+	private:
+		std::string dir;
+		unsigned long long limit; // in bytes
+		std::mutex mtx;
+		std::map<std::string, unsigned> users; // of the graphs in use, by key
+		void evict();
+};
@@ -9,7 +9,9 @@
  */
 
 #include "degreehandler.h"
+#include "graphfile.h"
 #include <cassert>
+#include <sys/mman.h>
 using namespace std;
 
 #define BYTE_OFFSET (2*sizeof(vx))
@@ -24,6 +26,29 @@ DegreeHandler::DegreeHandler(const std::string file, size_t bufSize)
 
 	const char* filename = file.c_str();
 	fd = fopen(filename, READ_FLAG);
+	offsets = NULL;
+	degrees = NULL;
+
+	GraphHeader header;
+	if (readGraphHeader(file, header))
+	{
+		graphSize = (vx) header.vertices;
+		offsetsSize = (header.vertices + 1)*sizeof(unsigned long long);
+		void* data = mmap(nullptr, 
+		                  offsetsSize, 
+		                  PROT_READ, 
+		                  MAP_PRIVATE, 
+		                  fileno(fd), 
+		                  header.offsetsStart);
+		if (data == MAP_FAILED)
+		{
+			cerr << "Error: could not map the offsets of " << file << endl;
+			exit(1);
+		}
+		offsets = static_cast<unsigned long long *> (data);
+		return;
+	}
+
 	graphSize = (getFileSize(filename)/BYTE_OFFSET);
 	degrees = new vx[bufferSize];
 	updateDegrees(0);
@@ -35,6 +60,10 @@ DegreeHandler::DegreeHandler(const std::string file, size_t bufSize)
 DegreeHandler::~DegreeHandler()
 {
 	delete[] degrees;
+	if (offsets != NULL)
+	{
+		munmap(offsets, offsetsSize);
+	}
 	fclose(fd);
 }
 
@@ -58,6 +87,11 @@ bool DegreeHandler::updateDegrees(vx lower)
 
 vx DegreeHandler::getDegree(vx v)
 {
+	if (offsets != NULL)
+	{
+		return (vx) (offsets[v+1] - offsets[v]);
+	}
+
 	if (low > v || high < v)
 	{
 		if (!updateDegrees(v))
@@ -83,6 +117,11 @@ NonSequentialDegreeHandler::~NonSequentialDegreeHandler()
 
 vx NonSequentialDegreeHandler::getDegree(vx x)
 {
+	if (offsets != NULL)
+	{
+		return DegreeHandler::getDegree(x);
+	}
+
 	vx answer;
 	fseek64(fd, sizeof(vx)*((size_t) x * 2 + 1) , SEEK_SET);
 	assert(1 == fread(&answer, sizeof(vx), 1, fd));
@@ -12,7 +12,8 @@
 
 #include "util.h"
 
-// class that makes degree handling transparent
+// class that makes degree handling transparent, for either a .deg file or
+// a graph container, whose offsets are mapped instead of buffered
 
 class DegreeHandler{
 	public:
@@ -23,12 +24,14 @@ class DegreeHandler{
 
 	protected:
 		FILE* fd;
+		unsigned long long* offsets;
 	private:
 		vx low;
 		vx high;
 		vx graphSize;
 		size_t bufferSize;
 		vx* degrees;
+		size_t offsetsSize;
 
 		bool updateDegrees(vx lower);
 };
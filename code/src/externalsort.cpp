@@ -0,0 +1,621 @@
+/*
+ * PDTL: Parallel and Distributed Triangle Listing for Massive Graphs
+ * Ilias Giechaskiel, George Panagopoulos, Eiko Yoneki
+ * 44th International Conference on Parallel Processing (ICPP), Beijing 2015
+ * 
+ * DOI: 10.1109/ICPP.2015.46
+ * 
+ * https://github.com/giech/pdtl
+ */
+
+#include "externalsort.h"
+
+#include <cerrno>
+#include <sstream>
+#include <thread>
+#include <unistd.h>
+#include <sys/resource.h>
+
+using namespace std;
+
+#define RADIX_BITS 8
+#define RADIX_SIZE (1 << RADIX_BITS)
+#define RADIX_DIGITS (2*sizeof(vx))
+
+#define MAX_VARINT ((sizeof(vx)*8 + 6)/7)
+#define RUN_BUFFER (4*1024*1024)
+#define MERGE_CHUNK (64*1024) // fewest edges read at a time from each run
+
+// byte d of the (from, to) key, counting from the least significant
+static inline unsigned radixDigit(const edge& e, unsigned d)
+{
+	vx v = d < sizeof(vx) ? e.second : e.first;
+	return (unsigned) (v >> (RADIX_BITS*(d % sizeof(vx)))) & (RADIX_SIZE - 1);
+}
+
+// LSD radix sort by (from, to), using scratch as the second buffer. Digits
+// on which all edges agree are skipped.
+static void radixSort(edge* data, edge* scratch, size_t size)
+{
+	if (size < 2)
+	{
+		return;
+	}
+
+	size_t (*count)[RADIX_SIZE] = new size_t[RADIX_DIGITS][RADIX_SIZE];
+	fill(&count[0][0], &count[0][0] + RADIX_DIGITS*RADIX_SIZE, 0);
+	size_t i;
+	unsigned d;
+	for (i = 0; i < size; ++i)
+	{
+		for (d = 0; d < RADIX_DIGITS; ++d)
+		{
+			++count[d][radixDigit(data[i], d)];
+		}
+	}
+
+	edge* src = data;
+	edge* dst = scratch;
+	for (d = 0; d < RADIX_DIGITS; ++d)
+	{
+		if (count[d][radixDigit(src[0], d)] == size)
+		{
+			continue;
+		}
+
+		size_t offset = 0;
+		unsigned b;
+		for (b = 0; b < RADIX_SIZE; ++b)
+		{
+			size_t c = count[d][b];
+			count[d][b] = offset;
+			offset += c;
+		}
+
+		for (i = 0; i < size; ++i)
+		{
+			dst[count[d][radixDigit(src[i], d)]++] = src[i];
+		}
+		swap(src, dst);
+	}
+
+	if (src != data)
+	{
+		copy(src, src + size, data);
+	}
+	delete[] count;
+}
+
+static inline void putVarint(unsigned char*& out, vx v)
+{
+	while (v >= 0x80)
+	{
+		*out++ = (unsigned char) (v | 0x80);
+		v >>= 7;
+	}
+	*out++ = (unsigned char) v;
+}
+
+// returns false if the varint is cut off at end
+static inline bool getVarint(const unsigned char*& in, 
+                             const unsigned char* end, 
+                             vx& v)
+{
+	v = 0;
+	unsigned shift = 0;
+	while (in < end)
+	{
+		unsigned char b = *in++;
+		v |= ((vx) (b & 0x7F)) << shift;
+		if (b < 0x80)
+		{
+			return true;
+		}
+		shift += 7;
+	}
+	return false;
+}
+
+// Writes a sorted run as the varint of the delta of from, followed by the
+// varint of to, itself a delta when from is unchanged. A run can be written
+// in several parts, with prev the last edge written so far.
+static void writeRun(const edge* data, 
+                     size_t size, 
+                     FILE* file, 
+                     const string name, 
+                     edge& prev)
+{
+	unsigned char* buffer = new unsigned char[RUN_BUFFER];
+	unsigned char* out = buffer;
+	size_t i;
+	for (i = 0; i <= size; ++i)
+	{
+		if (i == size || out + 2*MAX_VARINT > buffer + RUN_BUFFER)
+		{
+			size_t used = out - buffer;
+			if (fwrite(buffer, 1, used, file) != used)
+			{
+				cerr << "Error: could not write run " << name << ": " << errno << endl;
+				exit(1);
+			}
+			out = buffer;
+			if (i == size)
+			{
+				break;
+			}
+		}
+
+		const edge& e = data[i];
+		vx delta = e.first - prev.first;
+		putVarint(out, delta);
+		putVarint(out, delta == 0 ? e.second - prev.second : e.second);
+		prev = e;
+	}
+	fflush(file);
+	delete[] buffer;
+}
+
+// merges the sorted ranges [low, mid) and [mid, high) of src into dst
+static void mergePair(const edge* src, size_t low, size_t mid, size_t high, edge* dst)
+{
+	merge(src + low, src + mid, src + mid, src + high, dst + low);
+}
+
+// Merges the sorted slices of data, between consecutive bounds, pairwise and
+// in parallel until a single sorted slice is left in data
+static void mergeSlices(edge* data, edge* scratch, vector<size_t> bounds)
+{
+	edge* src = data;
+	edge* dst = scratch;
+	while (bounds.size() > 2)
+	{
+		size_t pairs = bounds.size()/2;
+		vector<size_t> merged;
+		thread* threadarr = new thread[pairs];
+		size_t p;
+		for (p = 0; p < pairs; ++p)
+		{
+			size_t low = bounds[2*p];
+			size_t mid = bounds[2*p+1];
+			size_t high = 2*p + 2 < bounds.size() ? bounds[2*p+2] : mid;
+			merged.push_back(low);
+			threadarr[p] = thread(mergePair, src, low, mid, high, dst);
+		}
+		merged.push_back(bounds.back());
+		for (p = 0; p < pairs; ++p)
+		{
+			threadarr[p].join();
+		}
+		delete[] threadarr;
+		swap(src, dst);
+		bounds = merged;
+	}
+
+	if (src != data)
+	{
+		copy(src, src + bounds.back(), data);
+	}
+}
+
+EdgeSorter::EdgeSorter(const string name, 
+                       size_t mem, 
+                       unsigned numthreads, 
+                       bool loops)
+{
+	base = name;
+	keepLoops = loops;
+	threads = numthreads > 0 ? numthreads : 1;
+	bounded = mem != 0;
+	if (bounded)
+	{
+		// half for the edges, half for the radix sort
+		memorySize = max(mem*1024*1024/sizeof(edge), (size_t) 2);
+		bufferSize = memorySize/2;
+	}
+	else
+	{
+		memorySize = DEFAULT_BUF;
+		bufferSize = memorySize;
+	}
+	memory = new edge[memorySize];
+	bufferIndex = 0;
+	merging = false;
+	hasLast = false;
+	runCount = 0;
+	chunk = 0;
+	byteChunk = 0;
+
+	const char* temp = getenv("PDTL_TEMP");
+	if (temp != NULL)
+	{
+		istringstream dirs(temp);
+		string dir;
+		while (getline(dirs, dir, ':'))
+		{
+			if (!dir.empty())
+			{
+				tempDirs.push_back(dir);
+			}
+		}
+	}
+
+	// many runs may be open at once
+	struct rlimit filelim;
+	getrlimit(RLIMIT_NOFILE, &filelim);
+	filelim.rlim_cur = filelim.rlim_max;
+	setrlimit(RLIMIT_NOFILE, &filelim);
+}
+
+EdgeSorter::~EdgeSorter()
+{
+	unsigned i;
+	for (i = 0; i < runs.size(); ++i)
+	{
+		if (runs[i].file != NULL)
+		{
+			fclose(runs[i].file);
+			remove(runs[i].name.c_str());
+		}
+	}
+	delete[] memory;
+}
+
+void EdgeSorter::addEdge(vx from, vx to)
+{
+	if (bufferIndex == bufferSize)
+	{
+		if (bounded)
+		{
+			sortBuffer(memory + bufferSize, true);
+		}
+		else
+		{
+			edge* larger = new edge[2*memorySize];
+			copy(memory, memory + memorySize, larger);
+			delete[] memory;
+			memory = larger;
+			memorySize *= 2;
+			bufferSize = memorySize;
+		}
+	}
+
+	memory[bufferIndex] = edge(from, to);
+	++bufferIndex;
+}
+
+string EdgeSorter::runName(size_t n)
+{
+	ostringstream tempname;
+	if (tempDirs.empty())
+	{
+		tempname << base << "-run-" << n;
+	}
+	else
+	{
+		size_t slash = base.find_last_of('/');
+		string name = slash == string::npos ? base : base.substr(slash + 1);
+		tempname << tempDirs[n % tempDirs.size()] << "/" << name << "-" 
+		         << getpid() << "-run-" << n;
+	}
+	return tempname.str();
+}
+
+// Splits the buffered edges between the threads, each of which radix sorts
+// its slice, merges the slices back together and turns the buffer into a
+// single new run, spilled to a file if requested
+void EdgeSorter::sortBuffer(edge* scratch, bool spill)
+{
+	vector<size_t> bounds(threads + 1);
+	thread* threadarr = new thread[threads];
+	unsigned i;
+	for (i = 0; i < threads; ++i)
+	{
+		bounds[i] = bufferIndex/threads*i;
+		size_t high = i == threads - 1 ? bufferIndex : bufferIndex/threads*(i+1);
+		threadarr[i] = thread(radixSort, memory + bounds[i], scratch + bounds[i], high - bounds[i]);
+	}
+	bounds[threads] = bufferIndex;
+	for (i = 0; i < threads; ++i)
+	{
+		threadarr[i].join();
+	}
+	delete[] threadarr;
+	mergeSlices(memory, scratch, bounds);
+
+	Run run;
+	run.file = NULL;
+	run.data = memory;
+	run.size = bufferIndex;
+	run.index = 0;
+	run.done = run.size == 0;
+	run.bytes = NULL;
+	run.byteSize = 0;
+	run.bytePos = 0;
+	if (spill)
+	{
+		run.name = runName(runCount++);
+		run.file = fopen(run.name.c_str(), "w+");
+		if (run.file == NULL)
+		{
+			cerr << "Error: could not create run " << run.name << ": " << errno << endl;
+			exit(1);
+		}
+		edge prev(0, 0);
+		writeRun(memory, bufferIndex, run.file, run.name, prev);
+	}
+	runs.push_back(run);
+	bufferIndex = 0;
+}
+
+// all of the memory is split between the first count runs, half of each part
+// for encoded bytes and half for decoded edges
+void EdgeSorter::layoutRuns(size_t count)
+{
+	chunk = memorySize/count/2;
+	byteChunk = chunk*sizeof(edge);
+	if (byteChunk < 2*MAX_VARINT)
+	{
+		cerr << "Too little memory" << endl;
+		exit(1);
+	}
+
+	size_t i;
+	for (i = 0; i < count; ++i)
+	{
+		runs[i].data = memory + 2*chunk*i;
+		runs[i].bytes = (char*) (memory + 2*chunk*i + chunk);
+	}
+}
+
+// Merges the oldest runs into a new one until few enough are left for each
+// to be read MERGE_CHUNK edges at a time. Each pass keeps the part of the
+// memory of one run to buffer its output.
+void EdgeSorter::mergePasses()
+{
+	size_t fanIn = max(memorySize/2/MERGE_CHUNK, (size_t) 3);
+	while (runs.size() > fanIn)
+	{
+		vector<Run> rest(runs.begin() + (fanIn - 1), runs.end());
+		runs.resize(fanIn - 1);
+		layoutRuns(fanIn);
+		rewindRuns();
+
+		Run out;
+		out.data = NULL;
+		out.size = 0;
+		out.index = 0;
+		out.done = false;
+		out.bytes = NULL;
+		out.byteSize = 0;
+		out.bytePos = 0;
+		out.name = runName(runCount++);
+		out.file = fopen(out.name.c_str(), "w+");
+		if (out.file == NULL)
+		{
+			cerr << "Error: could not create run " << out.name << ": " << errno << endl;
+			exit(1);
+		}
+		edge* buffer = memory + 2*chunk*(fanIn - 1);
+		size_t used = 0;
+		edge prev(0, 0);
+		vx from, to;
+		while (nextEdge(from, to))
+		{
+			buffer[used++] = edge(from, to);
+			if (used == 2*chunk)
+			{
+				writeRun(buffer, used, out.file, out.name, prev);
+				used = 0;
+			}
+		}
+		writeRun(buffer, used, out.file, out.name, prev);
+
+		size_t i;
+		for (i = 0; i < runs.size(); ++i)
+		{
+			fclose(runs[i].file);
+			remove(runs[i].name.c_str());
+		}
+		rest.push_back(out);
+		runs = rest;
+		cout << "Merged " << fanIn - 1 << " runs, " << runs.size() << " left" << endl;
+	}
+}
+
+void EdgeSorter::startMerge()
+{
+	if (!merging)
+	{
+		merging = true;
+		if (runs.empty())
+		{
+			// everything fits, so the run stays in memory
+			edge* scratch = bounded ? memory + bufferSize : new edge[bufferIndex + 1];
+			sortBuffer(scratch, false);
+			if (!bounded)
+			{
+				delete[] scratch;
+			}
+		}
+		else
+		{
+			if (bufferIndex > 0)
+			{
+				sortBuffer(memory + bufferSize, true);
+			}
+
+			mergePasses();
+			layoutRuns(runs.size());
+
+			unsigned long long bytes = 0;
+			unsigned i;
+			for (i = 0; i < runs.size(); ++i)
+			{
+				bytes += getFileSize(runs[i].name.c_str());
+			}
+			cout << runs.size() << " runs of " << bytes << " bytes" << endl;
+		}
+	}
+	rewindRuns();
+}
+
+// goes back to the start of every run
+void EdgeSorter::rewindRuns()
+{
+	hasLast = false;
+	unsigned i;
+	for (i = 0; i < runs.size(); ++i)
+	{
+		Run& run = runs[i];
+		run.index = 0;
+		if (run.file != NULL)
+		{
+			fseek64(run.file, 0, SEEK_SET);
+			run.byteSize = 0;
+			run.bytePos = 0;
+			run.prev = edge(0, 0);
+			run.done = !refill(i);
+		}
+		else
+		{
+			run.done = run.size == 0;
+		}
+	}
+	buildTree();
+}
+
+bool EdgeSorter::decode(Run& run, edge& e)
+{
+	const unsigned char* in = (const unsigned char*) run.bytes + run.bytePos;
+	const unsigned char* end = (const unsigned char*) run.bytes + run.byteSize;
+	vx delta, to;
+	if (!getVarint(in, end, delta) || !getVarint(in, end, to))
+	{
+		return false;
+	}
+
+	e.first = run.prev.first + delta;
+	e.second = delta == 0 ? run.prev.second + to : to;
+	run.prev = e;
+	run.bytePos = in - (const unsigned char*) run.bytes;
+	return true;
+}
+
+bool EdgeSorter::refill(unsigned r)
+{
+	Run& run = runs[r];
+	if (run.file == NULL)
+	{
+		return false;
+	}
+
+	run.size = 0;
+	run.index = 0;
+	while (run.size < chunk)
+	{
+		if (decode(run, run.data[run.size]))
+		{
+			++run.size;
+			continue;
+		}
+
+		// top up the encoded bytes, keeping a partially read edge
+		size_t left = run.byteSize - run.bytePos;
+		memmove(run.bytes, run.bytes + run.bytePos, left);
+		size_t got = fread(run.bytes + left, 1, byteChunk - left, run.file);
+		run.byteSize = left + got;
+		run.bytePos = 0;
+		if (got == 0)
+		{
+			break;
+		}
+	}
+	return run.size > 0;
+}
+
+bool EdgeSorter::beats(unsigned first, unsigned second)
+{
+	const Run& a = runs[first];
+	const Run& b = runs[second];
+	if (a.done)
+	{
+		return false;
+	}
+	return b.done || a.data[a.index] < b.data[b.index];
+}
+
+// Plays the initial matches bottom-up: the leaves are at k + run, the
+// internal nodes at 1 to k - 1, and each node keeps the loser of its match
+void EdgeSorter::buildTree()
+{
+	unsigned k = (unsigned) runs.size();
+	tree.assign(max(k, 1u), 0);
+	vector<unsigned> winners(2*k);
+	unsigned n;
+	for (n = 0; n < k; ++n)
+	{
+		winners[k + n] = n;
+	}
+	for (n = k - 1; n >= 1 && k > 1; --n)
+	{
+		unsigned a = winners[2*n];
+		unsigned b = winners[2*n+1];
+		bool aWins = beats(a, b);
+		winners[n] = aWins ? a : b;
+		tree[n] = aWins ? b : a;
+	}
+	tree[0] = k > 1 ? winners[1] : 0;
+}
+
+// after the head of run changes, replays its matches up to the root
+void EdgeSorter::replay(unsigned run)
+{
+	unsigned k = (unsigned) runs.size();
+	unsigned winner = run;
+	unsigned n;
+	for (n = (k + run)/2; n >= 1; n /= 2)
+	{
+		if (beats(tree[n], winner))
+		{
+			swap(tree[n], winner);
+		}
+	}
+	tree[0] = winner;
+}
+
+bool EdgeSorter::nextEdge(vx& from, vx& to)
+{
+	if (runs.empty())
+	{
+		return false;
+	}
+
+	while (true)
+	{
+		unsigned r = tree[0];
+		Run& run = runs[r];
+		if (run.done)
+		{
+			return false;
+		}
+
+		edge e = run.data[run.index];
+		++run.index;
+		if (run.index == run.size && !refill(r))
+		{
+			run.done = true;
+		}
+		replay(r);
+
+		if ((!keepLoops && e.first == e.second) || (hasLast && e == last))
+		{
+			continue;
+		}
+
+		last = e;
+		hasLast = true;
+		from = e.first;
+		to = e.second;
+		return true;
+	}
+}
@@ -0,0 +1,87 @@
+/*
+ * PDTL: Parallel and Distributed Triangle Listing for Massive Graphs
+ * Ilias Giechaskiel, George Panagopoulos, Eiko Yoneki
+ * 44th International Conference on Parallel Processing (ICPP), Beijing 2015
+ * 
+ * DOI: 10.1109/ICPP.2015.46
+ * 
+ * https://github.com/giech/pdtl
+ */
+
+#pragma once
+
+#include "util.h"
+
+#include <vector>
+
+// Sorts edges in bounded memory: full buffers are split between threads,
+// radix sorted, merged and spilled to a temporary run each. The runs are
+// then merged back in order with a loser tree, after merging the oldest ones
+// in extra passes while there are too many to read each in large blocks. The
+// merge can be repeated, and skips duplicate edges and, unless asked to keep
+// them, self-loops.
+//
+// Runs are delta and varint encoded. They are written next to base, or
+// spread round-robin over the directories listed in the PDTL_TEMP
+// environment variable, separated by colons.
+
+typedef std::pair<vx, vx> edge;
+
+class EdgeSorter {
+	public:
+		// memory in MB, with 0 keeping all edges in memory
+		EdgeSorter(const std::string base, 
+		           size_t mem = 0, 
+		           unsigned threads = 1, 
+		           bool keepLoops = false);
+		~EdgeSorter();
+		void addEdge(vx from, vx to);
+		void startMerge();
+		bool nextEdge(vx& from, vx& to);
+
+	private:
+		// a sorted run, either spilled to a file or still in memory
+		struct Run {
+			FILE* file;
+			std::string name;
+			edge* data;
+			size_t size;
+			size_t index;
+			bool done;
+			char* bytes; // encoded bytes read from file, not yet decoded
+			size_t byteSize;
+			size_t bytePos;
+			edge prev;
+		};
+
+		std::string base;
+		edge* memory; // the sort buffer followed by the radix scratch space
+		size_t memorySize;
+		size_t bufferSize;
+		size_t bufferIndex;
+		bool bounded;
+		unsigned threads;
+		bool keepLoops;
+
+		std::vector<std::string> tempDirs;
+		std::vector<Run> runs;
+		size_t runCount; // runs ever created, to name new ones
+		size_t chunk;
+		size_t byteChunk;
+		std::vector<unsigned> tree; // tree[0] is the winner, the rest losers
+
+		bool merging;
+		edge last;
+		bool hasLast;
+
+		std::string runName(size_t n);
+		void sortBuffer(edge* scratch, bool spill);
+		void layoutRuns(size_t count);
+		void mergePasses();
+		void rewindRuns();
+		bool decode(Run& run, edge& e);
+		bool refill(unsigned run);
+		bool beats(unsigned first, unsigned second);
+		void buildTree();
+		void replay(unsigned run);
+};
@@ -10,6 +10,9 @@
 
 #include "filebuffer.h"
 
+#include <cerrno>
+#include <unistd.h>
+
 using namespace std;
 
 // TODO: check not closed
@@ -70,3 +73,60 @@ void FileBuffer::close()
 	fclose(out);
 }
 
+
+OffsetFileBuffer::OffsetFileBuffer(int file, 
+                                   unsigned long long off, 
+                                   size_t size)
+{
+	fd = file;
+	offset = off;
+	bufferSize = size;
+	buffer = new vx[bufferSize];
+	bufferIndex = 0;
+	closed = false;
+}
+
+OffsetFileBuffer::~OffsetFileBuffer()
+{
+	if (!closed)
+	{
+		close();
+	}
+
+	delete[] buffer;
+}
+
+void OffsetFileBuffer::addToBuffer(vx v)
+{
+	buffer[bufferIndex] = v;
+	++bufferIndex;
+	if (bufferIndex == bufferSize)
+	{
+		flush();
+	}
+}
+
+void OffsetFileBuffer::flush()
+{
+	char* data = (char*) buffer;
+	size_t remaining = bufferIndex*sizeof(vx);
+	while (remaining > 0)
+	{
+		ssize_t written = pwrite(fd, data, remaining, offset);
+		if (written <= 0)
+		{
+			cerr << "Error: pwrite failed with " << errno << endl;
+			break;
+		}
+		data += written;
+		remaining -= written;
+		offset += written;
+	}
+	bufferIndex = 0;
+}
+
+void OffsetFileBuffer::close()
+{
+	closed = true;
+	flush();
+}
@@ -32,3 +32,26 @@ class FileBuffer {
 		void flush();
 };
 
+// Same as FileBuffer, but writes with pwrite starting at a fixed offset of
+// an already open descriptor, so that several threads can fill disjoint
+// regions of one file. Close before destruction.
+
+class OffsetFileBuffer {
+	public:
+		OffsetFileBuffer(int fd, 
+		                 unsigned long long offset, 
+		                 size_t bufferSize = DEFAULT_BUF);
+		~OffsetFileBuffer();
+		void addToBuffer(vx v);
+		void close();
+
+	private:
+		int fd;
+		unsigned long long offset;
+		vx* buffer;
+		size_t bufferSize;
+		size_t bufferIndex;
+		bool closed;
+		void flush();
+};
+
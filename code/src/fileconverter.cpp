@@ -9,6 +9,7 @@
  */
 
 #include <cstdio>
+#include <cerrno>
 #include <vector>
 #include <iostream>
 #include <sstream>
@@ -17,7 +18,7 @@
 #include <fstream>
 #include <unistd.h>
 #include <cmath>
-#include <sys/resource.h>
+#include <thread>
 #include <sys/types.h>
 #include <sys/mman.h>
 
@@ -25,361 +26,784 @@
 #include "util.h"
 #include "parserutil.h"
 #include "adjacencyhandler.h"
+#include "degreehandler.h"
+#include "externalsort.h"
+#include "graphfile.h"
+#include "inputstream.h"
 
 using namespace std;
 
-inline int todigit(char input)
+#define NOT_DIGIT 0xFF
+#define SNAP_BLOCK (64*1024*1024)
+#define SNAP_SPILL (1 << 20) // edges a thread buffers before writing them out
+
+// maps each character to its digit value, and everything else to NOT_DIGIT
+struct DigitTable {
+	unsigned char value[256];
+	DigitTable()
+	{
+		fill(value, value + 256, NOT_DIGIT);
+		for (int c = '0'; c <= '9'; ++c)
+		{
+			value[c] = (unsigned char) (c - '0');
+		}
+	}
+};
+
+static const DigitTable digits;
+
+SnapReader::SnapReader(const char* input)
 {
-	return input - '0';
+	fd = open(input, O_RDONLY);
+	size = lseek(fd, 0, SEEK_END);
+	lseek(fd, 0, SEEK_SET);
+	buf = NULL;
+	if (size > 0)
+	{
+		buf = static_cast<char *> (mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0));
+		madvise(buf, size, MADV_SEQUENTIAL);
+	}
+	index = 0;
+	own = true;
 }
 
-void parseAdjacencyList(const char* input, const char* output, int starter)
+SnapReader::SnapReader(const char* data, size_t size)
 {
-	int fd = open(input, O_RDONLY);
-	ParserUtil parser(output);
-	size_t size = lseek(fd, 0, SEEK_END);
-	lseek(fd, 0, SEEK_SET);
-	char *buf = static_cast<char *> (mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0));
+	fd = -1;
+	buf = const_cast<char *> (data);
+	this->size = size;
+	index = 0;
+	own = false;
+}
+
+SnapReader::SnapReader(const SnapReader& file, size_t begin, size_t end)
+{
+	fd = -1;
+	buf = file.buf;
+	size = end;
+	index = begin;
+	own = false;
+}
+
+SnapReader::~SnapReader()
+{
+	if (own)
+	{
+		if (buf != NULL)
+		{
+			munmap(buf, size);
+		}
+		close(fd);
+	}
+}
+
+size_t SnapReader::getSize() const
+{
+	return size;
+}
+
+size_t SnapReader::nextLine(size_t pos) const
+{
+	if (pos == 0)
+	{
+		return 0;
+	}
+
+	while (pos < size && buf[pos-1] != '\n')
+	{
+		++pos;
+	}
+	return pos;
+}
+
+bool SnapReader::nextNumber(vx& n)
+{
+	unsigned char d = NOT_DIGIT;
+	while (index < size && (d = digits.value[(unsigned char) buf[index]]) == NOT_DIGIT)
+	{
+		if (buf[index] == '#')
+		{
+			while (index < size && buf[index] != '\n')
+				++index;
+		}
+		else
+		{
+			++index;
+		}
+	}
+
+	if (index == size)
+	{
+		return false;
+	}
+
+	n = d;
+	++index;
+	while (index < size && (d = digits.value[(unsigned char) buf[index]]) != NOT_DIGIT)
+	{
+		n = n*10 + d;
+		++index;
+	}
+	return true;
+}
+
+bool SnapReader::nextEdge(vx& from, vx& to)
+{
+	return nextNumber(from) && nextNumber(to);
+}
+
+// edges parsed by one thread from a range of lines, spilled in file order
+struct SnapChunk {
+	string name;
+	FILE* file;
+	unsigned long long count;
+	bool sorted; // in (source, destination) order
+	edge first;
+	edge last;
+	vx maxVx;
+};
+
+static void openSnapChunk(SnapChunk* chunk, const string& name, const char* mode)
+{
+	chunk->name = name;
+	chunk->file = fopen(name.c_str(), mode);
+	if (chunk->file == NULL)
+	{
+		cerr << "Error: could not open " << name << ": " << errno << endl;
+		exit(1);
+	}
+}
+
+static void spillSnapEdges(SnapChunk* chunk, const edge* edges, size_t count)
+{
+	if (fwrite(edges, sizeof(edge), count, chunk->file) != count)
+	{
+		cerr << "Error: could not write " << chunk->name << ": " << errno << endl;
+		exit(1);
+	}
+}
+
+static void parseSnapRange(const SnapReader* file, 
+                           size_t begin, 
+                           size_t end, 
+                           SnapChunk* chunk)
+{
+	SnapReader reader(*file, begin, end);
+	edge* buffer = new edge[SNAP_SPILL];
+	size_t used = 0;
 	vx from, to;
-	bool foundfrom = false;
-	for(size_t i = 0; i < size; i++)
+	chunk->count = 0;
+	chunk->sorted = true;
+	chunk->maxVx = 0;
+	while (reader.nextEdge(from, to))
 	{
-		if(buf[i] == '#')
+		edge e(from, to);
+		if (chunk->count == 0)
 		{
-			while(i < size && buf[++i] != '\n');
-			++i;
-			if(i >= size) break;
+			chunk->first = e;
 		}
-		while(!isdigit(buf[i]) && i < size)
-			i++;
-		if(i == size) break;
-		if(!foundfrom)
+		else if (e < chunk->last)
 		{
-			from = todigit(buf[i]);
-			int temp = todigit(buf[++i]);
-			while(temp <= 9 && temp >= 0)
+			chunk->sorted = false;
+		}
+		chunk->last = e;
+		++chunk->count;
+		chunk->maxVx = max(chunk->maxVx, max(from, to));
+
+		buffer[used++] = e;
+		if (used == SNAP_SPILL)
+		{
+			spillSnapEdges(chunk, buffer, used);
+			used = 0;
+		}
+	}
+	spillSnapEdges(chunk, buffer, used);
+	delete[] buffer;
+}
+
+// parses the lines of file with one range per thread, into chunks
+static void parseSnapChunks(const SnapReader& file, 
+                            unsigned threads, 
+                            SnapChunk* chunks)
+{
+	size_t size = file.getSize();
+	thread* threadarr = new thread[threads];
+	unsigned i;
+	for (i = 0; i < threads; ++i)
+	{
+		size_t begin = file.nextLine(size/threads*i);
+		size_t end = i == threads - 1 ? size : file.nextLine(size/threads*(i+1));
+		threadarr[i] = thread(parseSnapRange, &file, begin, end, &chunks[i]);
+	}
+	for (i = 0; i < threads; ++i)
+	{
+		threadarr[i].join();
+	}
+	delete[] threadarr;
+}
+
+// the edges of the chunk that follows, in the order of the file
+static void appendSnapChunk(SnapChunk* all, const SnapChunk& next)
+{
+	if (next.count == 0)
+	{
+		return;
+	}
+	all->sorted = all->sorted && next.sorted && (all->count == 0 || all->last <= next.first);
+	if (all->count == 0)
+	{
+		all->first = next.first;
+	}
+	all->last = next.last;
+	all->count += next.count;
+	all->maxVx = max(all->maxVx, next.maxVx);
+}
+
+// reads back the edges spilled to the chunks, in order, and removes them
+template <typename Add>
+static void readSnapChunks(vector<SnapChunk>& chunks, Add add)
+{
+	edge* buffer = new edge[SNAP_SPILL];
+	size_t i;
+	for (i = 0; i < chunks.size(); ++i)
+	{
+		rewind(chunks[i].file);
+		size_t got;
+		while ((got = fread(buffer, sizeof(edge), SNAP_SPILL, chunks[i].file)) > 0)
+		{
+			size_t e;
+			for (e = 0; e < got; ++e)
+			{
+				add(buffer[e].first, buffer[e].second);
+			}
+		}
+		fclose(chunks[i].file);
+		remove(chunks[i].name.c_str());
+	}
+	delete[] buffer;
+}
+
+// Passes successive blocks of whole lines of a compressed file to parse,
+// while the next block is decompressed
+template <typename Parse>
+static void parseSnapBlocks(const char* input, Parse parse)
+{
+	InputStream stream(input);
+	char* block = new char[SNAP_BLOCK];
+	size_t carry = 0;
+	while (true)
+	{
+		size_t size = carry + stream.read(block + carry, SNAP_BLOCK - carry);
+		bool last = size < SNAP_BLOCK;
+		size_t end = size;
+		while (!last && end > 0 && block[end-1] != '\n')
+		{
+			--end;
+		}
+		if (end == 0 && !last)
+		{
+			cerr << "Error: line longer than " << SNAP_BLOCK << " bytes in " << input << endl;
+			exit(1);
+		}
+
+		SnapReader reader(block, end);
+		parse(reader);
+		if (last)
+		{
+			break;
+		}
+		carry = size - end;
+		memmove(block, block + end, carry);
+	}
+	delete[] block;
+}
+
+// Each thread parses a range of whole lines, of the whole file or, for a
+// compressed file, of each decompressed block in turn, and spills its edges to
+// a temporary file next to the output. If the edges turn out to be sorted by
+// source and then destination, the files are written out in order, skipping
+// repeated edges; otherwise the edges are sorted in mem MB with the
+// EdgeSorter, which drops duplicate edges too, so that the same edges give
+// the same graph whatever their order.
+void parseAdjacencyList(const char* input, const char* output, size_t mem, unsigned threads)
+{
+	if (threads == 0)
+	{
+		threads = 1;
+	}
+
+	string spill = string(output) + "-snap-";
+	vector<SnapChunk> chunks(threads);
+	SnapChunk all;
+	all.count = 0;
+	all.sorted = true;
+	all.maxVx = 0;
+	unsigned i;
+	if (InputStream::isCompressed(input))
+	{
+		// the ranges of each block are appended in order to a single file
+		vector<SnapChunk> parts(threads);
+		for (i = 0; i < threads; ++i)
+		{
+			openSnapChunk(&parts[i], spill + to_string(i + 1), "w+b");
+		}
+		chunks.resize(1);
+		openSnapChunk(&chunks[0], spill + "0", "w+b");
+		edge* buffer = new edge[SNAP_SPILL];
+		parseSnapBlocks(input, [&](const SnapReader& block) {
+			parseSnapChunks(block, threads, &parts[0]);
+			for (i = 0; i < threads; ++i)
 			{
-				from = from*10 + temp;
-				temp = todigit(buf[++i]);
+				appendSnapChunk(&all, parts[i]);
+				rewind(parts[i].file);
+				size_t got;
+				while ((got = fread(buffer, sizeof(edge), SNAP_SPILL, parts[i].file)) > 0)
+				{
+					spillSnapEdges(&chunks[0], buffer, got);
+				}
+				rewind(parts[i].file);
+				if (ftruncate(fileno(parts[i].file), 0) != 0)
+				{
+					cerr << "Error: could not truncate " << parts[i].name << ": " << errno << endl;
+					exit(1);
+				}
 			}
-			foundfrom = true;
-		} else {
-			to = todigit(buf[i]);
-			int temp = todigit(buf[++i]);
-			while(temp <= 9 && temp >= 0)
+		});
+		delete[] buffer;
+		for (i = 0; i < threads; ++i)
+		{
+			fclose(parts[i].file);
+			remove(parts[i].name.c_str());
+		}
+	}
+	else
+	{
+		for (i = 0; i < threads; ++i)
+		{
+			openSnapChunk(&chunks[i], spill + to_string(i), "w+b");
+		}
+		SnapReader file(input);
+		parseSnapChunks(file, threads, &chunks[0]);
+		for (i = 0; i < threads; ++i)
+		{
+			appendSnapChunk(&all, chunks[i]);
+		}
+	}
+	cout << "Parsed " << (all.sorted ? "sorted" : "unsorted") << " input" << endl;
+
+	ParserUtil parser(output);
+	if (all.sorted)
+	{
+		edge last;
+		bool hasLast = false;
+		readSnapChunks(chunks, [&](vx from, vx to) {
+			if (!hasLast || last != edge(from, to))
 			{
-				to = to*10 + temp;
-				temp = todigit(buf[++i]);
+				parser.addEdge(from, to);
 			}
-			foundfrom = false;
+			last = edge(from, to);
+			hasLast = true;
+		});
+	}
+	else
+	{
+		EdgeSorter sorter(output, mem, threads, true);
+		readSnapChunks(chunks, [&](vx from, vx to) {
+			sorter.addEdge(from, to);
+		});
+		vx from, to;
+		sorter.startMerge();
+		while (sorter.nextEdge(from, to))
+		{
 			parser.addEdge(from, to);
 		}
 	}
-	munmap(buf, size);
-	close(fd);
+	parser.close();
 }
 
 
 
-int xstream_comp(const void *first, const void *second)
+// Adds the (source, destination) pairs of an X-Stream file of vn-tuples,
+// which may be compressed, also in reverse if undirected is set
+static void addXStreamEdges(const char* inputname, 
+                            unsigned int vn, 
+                            EdgeSorter& sorter, 
+                            bool undirected)
 {
-	const vx *firsta = (vx *) first;
-	const vx *seconda = (vx *) second;
-	if(firsta[0] < seconda[0]) return -1;
-	else if(firsta[0] == seconda[0]) {
-		if(firsta[1] < seconda[1])
-			return -1;
-		else if(firsta[1] == seconda[1])
-			return 0;
-		else
-			return 1;
+	InputStream input(inputname);
+	size_t bufSize = ((size_t) (DEFAULT_BUF/vn))*vn;
+	vx* buffer = new vx[bufSize];
+	size_t size;
+	while (0 < (size = input.read(buffer, bufSize*sizeof(vx))))
+	{
+		if (size % (vn*sizeof(vx)))
+		{
+			cerr << "Error: Corrupted file " << inputname << endl;
+			exit(1);
+		}
+		size /= sizeof(vx);
+		for (size_t i = 0; i < size; i += vn)
+		{
+			sorter.addEdge(buffer[i], buffer[i+1]);
+			if (undirected)
+			{
+				sorter.addEdge(buffer[i+1], buffer[i]);
+			}
+		}
 	}
-	else
-		return 1;
+	delete[] buffer;
 }
 
-// qsort chunks, save them in files and then merge
+// sort runs of edges in parallel, save them in files and then merge
 void parseXStream(const char *inputname, 
 		              const char *outputname, 
 		              size_t mem, 
-		              unsigned int vn)
+		              unsigned int vn, 
+		              unsigned threads)
 {
-	FILE *input;
-	input = fopen(inputname, "r");
-	struct rlimit filelim;
-	getrlimit(RLIMIT_NOFILE, &filelim);
-	filelim.rlim_cur = filelim.rlim_max;
-	setrlimit(RLIMIT_NOFILE, &filelim);
-	if(mem == 0)
-	{
-		fseek64(input, 0, SEEK_END);
-		mem = ftell(input) + 8; // size of file plus overhead
-		fseek64(input, 0, SEEK_SET);
+	EdgeSorter sorter(outputname, mem, threads);
+	addXStreamEdges(inputname, vn, sorter, false);
+
+	ParserUtil parser(outputname);
+	vx from, to;
+	sorter.startMerge();
+	while (sorter.nextEdge(from, to))
+	{
+		parser.addEdge(from, to);
 	}
-	else
+	parser.close();
+}
+
+#define OPT_BUFFER (16*1024*1024)
+#define OPT_LINE 64
+#define SMALL_LIST 32
+
+// writes v in decimal at out, and returns the end of the digits
+static inline char* formatVx(char* out, vx v)
+{
+	char digits[24];
+	int n = 0;
+	do
 	{
-	  mem *= MB_TO_B;
+		digits[n++] = (char) ('0' + v % 10);
+		v /= 10;
+	} while (v != 0);
+
+	while (n > 0)
+	{
+		*out++ = digits[--n];
 	}
+	return out;
+}
 
-	size_t bufSize = ((size_t)(mem/sizeof(vx)/vn)) * vn;
-	vx *buffer = (vx*)malloc(bufSize*sizeof(vx));
-	size_t size, index = 0;
-	vector <FILE *> temp_files;
-	while(0 < (size = fread(buffer, sizeof(vx), bufSize, input)))
+// sorts a neighbor list with an LSD radix sort, skipping uniform digits,
+// and with an insertion sort for short lists
+static void sortNeighbors(vx* data, vx* scratch, size_t size)
+{
+	if (size < SMALL_LIST)
 	{
-		if(size % vn)
+		for (size_t i = 1; i < size; ++i)
 		{
-			cerr << "Error: Corrupted file " << inputname << endl;
-			fclose(input);
-			exit(1);
-		}
-		qsort(buffer, size/vn, sizeof(vx) * vn, &xstream_comp);
-		FILE *temp;
-		ostringstream tempname;
-		tempname << "__temp_" << index;
-		temp = fopen(tempname.str().c_str(), "w+");
-		if(temp == NULL) { cerr << errno << endl; return; }
-		fwrite(buffer, sizeof(vx), size, temp);
-		fflush(temp);
-		index++;
-		temp_files.push_back(temp);
-	}
-
-	// merge the files
-	size_t size_read[index], indices[index];
-	bool complete[index];
-	size_t chunk = ((size_t) (bufSize / (index+1) / vn)) * vn;
-	if(chunk == 0)
-	{
-		cerr << "Too little memory" << endl;
-		fclose(input);
-		exit(1);
-	}
-	buffer = (vx *) realloc(buffer, chunk*index*sizeof(vx));
-	ParserUtil parser(outputname, chunk/2);
-	for(vx i = 0; i < index; i++) {
-		fseek64(temp_files[i], 0, SEEK_SET);
-		size_read[i] = fread(&buffer[chunk*i], sizeof(vx), chunk,
-				temp_files[i]);
-		indices[i] = 0;
-		complete[i] = false;
-	}
-	vx index_smallest = 0, i;
-	vx previous[2];
-	bool has_previous = false;
-	while(true)
-	{
-		for(i = 0; i < index; i++)
-			if(!complete[i]) {
-				index_smallest = i;
-				break;
-			}
-		if(i == index)
-			break;
-		// find the smallest
-		for(i++; i < index; i++)
-		{
-			if(complete[i]) continue;
-			if(xstream_comp(&buffer[chunk*index_smallest + indices[index_smallest]],
-						&buffer[chunk*i + indices[i]]) > 0)
-				index_smallest = i;
-		}
-		unsigned long location = chunk*index_smallest + indices[index_smallest];
-		if((!has_previous || 
-		    buffer[location] != previous[0] || 
-				buffer[location+1] != previous[1]) &&
-				buffer[location] != buffer[location+1])
-		{
-			has_previous = true;
-			previous[0] = buffer[location];
-			previous[1] = buffer[location+1];
-			parser.addEdge(previous[0], previous[1]);
-		}
-		indices[index_smallest] += vn;
-		if(indices[index_smallest] == size_read[index_smallest]) {
-			size_read[index_smallest] = fread(&buffer[chunk*index_smallest], 
-			                                  sizeof(vx), 
-			                                  chunk,
-					                              temp_files[index_smallest]);
-			if(size_read[index_smallest] <= 0)
+			vx v = data[i];
+			size_t j = i;
+			for (; j > 0 && data[j-1] > v; --j)
 			{
-				complete[index_smallest] = true;
-				fclose(temp_files[index_smallest]);
-				ostringstream tempname;
-				tempname << "__temp_" << index_smallest;
-				unlink(tempname.str().c_str());
+				data[j] = data[j-1];
 			}
-			indices[index_smallest] = 0;
+			data[j] = v;
 		}
+		return;
+	}
+
+	vx* src = data;
+	vx* dst = scratch;
+	size_t count[256];
+	for (unsigned shift = 0; shift < 8*sizeof(vx); shift += 8)
+	{
+		fill(count, count + 256, 0);
+		for (size_t i = 0; i < size; ++i)
+		{
+			++count[(src[i] >> shift) & 0xFF];
+		}
+		if (count[(src[0] >> shift) & 0xFF] == size)
+		{
+			continue;
+		}
+
+		size_t sum = 0;
+		for (unsigned b = 0; b < 256; ++b)
+		{
+			size_t c = count[b];
+			count[b] = sum;
+			sum += c;
+		}
+		for (size_t i = 0; i < size; ++i)
+		{
+			dst[count[(src[i] >> shift) & 0xFF]++] = src[i];
+		}
+		swap(src, dst);
+	}
+
+	if (src != data)
+	{
+		copy(src, src + size, data);
 	}
-	parser.close();
-	fclose(input);
-	free(buffer);
 }
 
+static void writeAll(int fd, const char* data, size_t size, const string& name)
+{
+	while (size > 0)
+	{
+		ssize_t written = write(fd, data, size);
+		if (written <= 0)
+		{
+			cerr << "Error: could not write " << name << ": " << errno << endl;
+			exit(1);
+		}
+		data += written;
+		size -= written;
+	}
+}
 
+// maps a file of count elements, which is removed as soon as it is unmapped
+template <typename T>
+static T* mapTemporary(const string name, size_t count, size_t& bytes)
+{
+	bytes = max(count, (size_t) 1)*sizeof(T);
+	int fd = open(name.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0 || ftruncate(fd, bytes) != 0)
+	{
+		cerr << "Error: could not create " << name << ": " << errno << endl;
+		exit(1);
+	}
 
-class OPTConverter : public AdjacencyHandler {
+	void* data = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	unlink(name.c_str());
+	if (data == MAP_FAILED)
+	{
+		cerr << "Error: could not map " << name << ": " << errno << endl;
+		exit(1);
+	}
+	return static_cast<T *> (data);
+}
+
+// Relabels vertices by decreasing degree, without self-loops, and writes each
+// edge once, as "i j" with j < i. The ranking is sorted externally within
+// mem MB, while the per-vertex tables are kept in mapped temporary files,
+// so that only the neighbor lists being formatted are held in memory. Each
+// thread writes the lines of a range of new ids, balanced by degree.
+class OPTConverter {
 	public:
-		OPTConverter(const char *input, 
-		             const char *output, 
-		             size_t bufferSize = DEFAULT_BUF)
-			: AdjacencyHandler(input, bufferSize), buf_size(bufferSize)
-		{
-			degree_name = getDegName(input);
-			size = getFileSize(degree_name.c_str())/sizeof(vx);
-			buf = new vx[size];
-			inds = new vx[size/2];
-			start = new unsigned long long[size/2];
-			cur = new unsigned long long[size/2];
-			cout << "Reading .deg file" << endl;
-			fdin = fopen(degree_name.c_str(), READ_FLAG);
-			if(fread(buf, sizeof(vx), size, fdin) != size)
+		OPTConverter(const char* input, 
+		             const char* output, 
+		             size_t mem, 
+		             unsigned threads)
+			: input(input), output(output), mem(mem), threads(threads > 0 ? threads : 1)
+		{
+			unsigned long long edges;
+			adj = mapAdjacency(input, edges);
+			adjSize = edges*sizeof(vx);
+			order = NULL;
+		}
+
+		~OPTConverter()
+		{
+			unmapAdjacency(adj, adjSize/sizeof(vx));
+			munmap(offsets, offsetsSize);
+			munmap(map, mapSize);
+			if (order != NULL)
+			{
+				munmap(order, orderSize);
+			}
+		}
+
+		void convert()
+		{
+			rank();
+
+			cout << "Writing final graph" << endl;
+			int fd = open(output.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+			if (fd < 0)
 			{
-				cerr << "Error reading" << endl;
+				cerr << "Error: could not create " << output << ": " << errno << endl;
 				exit(1);
 			}
-			cout << "Passing .adj file for A-A edges" << endl;
-			int fd = open(getAdjName(input).c_str(), O_RDONLY);
-			size_t adjsize = lseek(fd, 0, SEEK_END);
-			lseek(fd, 0, SEEK_SET);
-			vx *adjbuf = static_cast<vx *> (mmap(nullptr, 
-			                                     adjsize, 
-			                                     PROT_READ, 
-			                                     MAP_PRIVATE, 
-			                                     fd, 
-			                                     0));
-			unsigned long long counter = 0, deg = buf[1];
-			vx ver = 0;
-			for(size_t i = 0; i < adjsize/sizeof(vx); i++)
+			char header[OPT_LINE];
+			char* end = formatVx(header, numVer);
+			*end++ = ' ';
+			end = formatVx(end, (vx) (edgeCount/2));
+			*end++ = '\r';
+			*end++ = '\n';
+			writeAll(fd, header, end - header, output);
+
+			// the first range goes straight to the output, the rest to parts
+			vector<thread> workers;
+			vector<int> parts(threads, fd);
+			for (unsigned t = 1; t < threads; ++t)
 			{
-				while(!deg)
-				{
-					ver++;
-					deg = buf[2*ver+1];
-				}
-				if(adjbuf[i] == ver)
+				string name = partName(t);
+				parts[t] = open(name.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+				if (parts[t] < 0)
 				{
-					counter++;
-					buf[ver*2+1]--;
+					cerr << "Error: could not create " << name << ": " << errno << endl;
+					exit(1);
 				}
-				deg--;
+				workers.push_back(thread(&OPTConverter::writeRange, 
+				                         this, 
+				                         lowVx[t], 
+				                         lowVx[t+1], 
+				                         parts[t]));
 			}
-			if(deg)
+			writeRange(lowVx[0], lowVx[1], fd);
+			for (auto& worker : workers)
 			{
-				cout << "Something is wrong, deg != 0" << endl;
+				worker.join();
 			}
-			munmap(adjbuf, adjsize);
-			close(fd);
-			cout << counter << " edges removed" << endl;
-			cout << "Sorting" << endl;
-			qsort(buf, size/2, sizeof(vx)*2, &(OPTConverter::compardeg));
-			cout << "Indexing" << endl;
-			num_ver = size/2;
-			unsigned long long cumu = 0;
-			for(size_t i = 0; i < size; i+=2)
+
+			char* buffer = new char[OPT_BUFFER];
+			for (unsigned t = 1; t < threads; ++t)
 			{
-				start[i/2] = cur[i/2] = cumu;
-				cumu += buf[i+1];
-				inds[buf[i]] = i/2;
-				if(!buf[i+1])
+				lseek(parts[t], 0, SEEK_SET);
+				ssize_t got;
+				while ((got = read(parts[t], buffer, OPT_BUFFER)) > 0)
 				{
-					num_ver = i/2;
-					break;
+					writeAll(fd, buffer, got, output);
 				}
+				close(parts[t]);
+				unlink(partName(t).c_str());
 			}
-			delete[] buf;
-			edges = new vx[getFileSize(getAdjName(input).c_str())/sizeof(vx)];
-			edge_size = 0;
-			fdout = fopen(output, "w");
-			fprintf(fdout, "%u ", num_ver);
+			delete[] buffer;
+			close(fd);
 		}
 
 	private:
-		FILE *fdin, *fdout;
-		vx num_ver;
-		size_t size, edge_size, buf_size;
-		vx *buf, *inds, *edges;
-		char *buffer;
-		unsigned long long *start, *cur;
-		string degree_name;
-
-		static int compardeg(const void *first, const void *second)
-		{
-			vx degf = static_cast<const vx *> (first)[1];
-			vx degs = static_cast<const vx *> (second)[1];
-			if(degf > degs)
-				return -1;
-			else if(degf < degs)
-				return 1;
-			else
-				return 0;
-		}
-
-		static int comparedge(const void *first, const void *second)
-		{
-			vx f = *static_cast<const vx *>(first);
-			vx s = *static_cast<const vx *>(second);
-			if(f < s)
-				return -1;
-			else if(f > s)
-				return 1;
-			else
-				return 0;
-		}
-
-		virtual void overallSetUp() { cout << "Reading .adj" << endl; }
-		virtual void processPhase() {}
-		virtual void phaseSetUp() {}
-		virtual void overallTearDown()
+		string input, output;
+		size_t mem;
+		unsigned threads;
+		vx* adj;
+		size_t adjSize;
+		vx graphSize, numVer;
+		unsigned long long edgeCount;
+		unsigned long long* offsets; // .adj offset of each old id
+		vx* map; // old id to new id
+		vx* order; // new id to old id
+		size_t offsetsSize, mapSize, orderSize;
+		vector<vx> lowVx;
+
+		string partName(unsigned t)
 		{
-			cout << "Writing final graph" << endl;
-			delete[] inds;
-			size_t output_index = 0;
-			buffer = new char[buf_size];
-			fprintf(fdout, "%lu\r\n", edge_size/2);
-			for(vx i = 0; i < num_ver; i++)
+			return output + "-part-" + to_string(t);
+		}
+
+		void rank()
+		{
+			cout << "Ranking vertices by degree" << endl;
+			DegreeHandler scan(getDegFile(input.c_str()));
+			graphSize = (vx) scan.getGraphSize();
+			offsets = mapTemporary<unsigned long long>(output + "-opt-offsets", 
+			                                           graphSize + 1, 
+			                                           offsetsSize);
+			map = mapTemporary<vx>(output + "-opt-map", graphSize, mapSize);
+			madvise(adj, adjSize, MADV_SEQUENTIAL);
+
+			// the key sorts by decreasing degree, and then by id
+			EdgeSorter sorter(output + "-opt", mem, threads, true);
+			unsigned long long off = 0, loops = 0;
+			edgeCount = 0;
+			numVer = 0;
+			for (vx v = 0; v < graphSize; ++v)
 			{
-				if(i != num_ver-1 && cur[i] != start[i+1])
-					cout << "Something is wrong cur != start for " << i << endl;
-				qsort(&edges[start[i]], 
-				      cur[i]-start[i], 
-				      sizeof(vx), 
-				      &(OPTConverter::comparedge));
-				for(unsigned long long j = start[i]; j < cur[i]; j++) {
-					if(i < edges[j]) break;
-					long long left = buf_size - output_index;
-					int written = snprintf(&buffer[output_index], left,
-							"%u %u\r\n", i, edges[j]);
-					if(written >= left)
-					{
-						fwrite(buffer, sizeof(char), output_index, fdout);
-						output_index = sprintf(buffer, "%u %u\r\n", i, edges[j]);
-					} else
-						output_index += written;
+				vx d = scan.getDegree(v);
+				offsets[v] = off;
+				if ((off + d)*sizeof(vx) > adjSize)
+				{
+					cerr << "Error: .deg and .adj files do not match" << endl;
+					exit(1);
+				}
+				vx self = (vx) count(adj + off, adj + off + d, v);
+				loops += self;
+				d -= self;
+				off += d + self;
+				if (d > 0)
+				{
+					sorter.addEdge(~d, v);
+					edgeCount += d;
+					++numVer;
 				}
 			}
-			delete[] start;
-			delete[] cur;
-			delete[] edges;
-			fwrite(buffer, sizeof(char), output_index, fdout);
-			delete[] buffer;
-			fclose(fdout);
+			offsets[graphSize] = off;
+			cout << loops << " edges removed" << endl;
+			madvise(adj, adjSize, MADV_RANDOM);
+
+			order = mapTemporary<vx>(output + "-opt-order", numVer, orderSize);
+			lowVx.assign(threads + 1, numVer);
+			unsigned long long cumulative = 0;
+			unsigned t = 0;
+			vx key, v, n = 0;
+			sorter.startMerge();
+			while (sorter.nextEdge(key, v))
+			{
+				while (t < threads && cumulative >= edgeCount/threads*t)
+				{
+					lowVx[t++] = n;
+				}
+				order[n] = v;
+				map[v] = n;
+				cumulative += (vx) ~key;
+				++n;
+			}
 		}
-		virtual bool handleEdge(vx from, vx to, vx degree)
+
+		void writeRange(vx low, vx high, int fd)
 		{
-			if(from != to) {
-				edge_size++;
-				edges[cur[inds[from]]++] = inds[to];
+			char* buffer = new char[OPT_BUFFER];
+			size_t pos = 0;
+			vector<vx> list, scratch;
+			for (vx i = low; i < high; ++i)
+			{
+				vx old = order[i];
+				unsigned long long begin = offsets[old], end = offsets[old+1];
+				if (list.size() < end - begin)
+				{
+					list.resize(end - begin);
+					scratch.resize(end - begin);
+				}
+
+				size_t n = 0;
+				for (unsigned long long k = begin; k < end; ++k)
+				{
+					if (adj[k] != old && map[adj[k]] < i)
+					{
+						list[n++] = map[adj[k]];
+					}
+				}
+				sortNeighbors(list.data(), scratch.data(), n);
+
+				for (size_t j = 0; j < n; ++j)
+				{
+					if (pos + OPT_LINE > OPT_BUFFER)
+					{
+						writeAll(fd, buffer, pos, output);
+						pos = 0;
+					}
+					char* out = formatVx(buffer + pos, i);
+					*out++ = ' ';
+					out = formatVx(out, list[j]);
+					*out++ = '\r';
+					*out++ = '\n';
+					pos = out - buffer;
+				}
 			}
-			return true;
+			writeAll(fd, buffer, pos, output);
+			delete[] buffer;
 		}
 };
 
-void convertToOPT(const char* input, const char* output)
+void convertToOPT(const char* input, const char* output, size_t mem, unsigned threads)
 {
-	OPTConverter converter(input, output);
-	converter.processAdjacency(0, MAX_EDGES);
+	OPTConverter converter(input, output, mem, threads);
+	converter.convert();
 }
 
 class XStreamConverter : public AdjacencyHandler {
@@ -413,3 +837,86 @@ void convertToXStream(const char* input, const char* output)
 	converter.processAdjacency(0, MAX_EDGES);
 }
 
+
+// Fused parse, undirect, order and orient: every edge is added in both
+// directions to shared sorted runs, and two merges over them replace the
+// intermediate graphs. The first counts the undirected degrees (and writes
+// the undirected graph if asked), the second writes the oriented graph.
+vx ingest(const char* input, 
+          const char* output, 
+          bool snap, 
+          size_t mem, 
+          unsigned int vn, 
+          bool keepUndirected, 
+          unsigned threads)
+{
+	EdgeSorter sorter(output, mem, threads);
+	vx from, to;
+
+	if (snap)
+	{
+		auto add = [&](SnapReader& reader) {
+			while (reader.nextEdge(from, to))
+			{
+				sorter.addEdge(from, to);
+				sorter.addEdge(to, from);
+			}
+		};
+		if (InputStream::isCompressed(input))
+		{
+			parseSnapBlocks(input, add);
+		}
+		else
+		{
+			SnapReader reader(input);
+			add(reader);
+		}
+	}
+	else
+	{
+		addXStreamEdges(input, vn, sorter, true);
+	}
+	cout << "Runs created" << endl;
+
+	vector<vx> degrees;
+	ParserUtil* undirected = NULL;
+	if (keepUndirected)
+	{
+		undirected = new ParserUtil(string(output) + "-undirected");
+	}
+
+	sorter.startMerge();
+	while (sorter.nextEdge(from, to))
+	{
+		if (degrees.size() <= from)
+		{
+			degrees.resize((size_t) from + 1, 0);
+		}
+		++degrees[from];
+		if (undirected != NULL)
+		{
+			undirected->addEdge(from, to);
+		}
+	}
+
+	if (undirected != NULL)
+	{
+		undirected->close();
+		delete undirected;
+	}
+	cout << "Degrees counted" << endl;
+
+	ParserUtil parser(output);
+	sorter.startMerge();
+	while (sorter.nextEdge(from, to))
+	{
+		vx degFrom = degrees[from];
+		vx degTo = degrees[to];
+		if ((degFrom < degTo) || (degFrom == degTo && from < to))
+		{
+			parser.addEdge(from, to);
+		}
+	}
+	parser.close();
+	return parser.getMaxDegree();
+}
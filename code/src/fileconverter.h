@@ -14,7 +14,38 @@
 
 // defines parser utilities
 
-void parseAdjacencyList(const char* input, const char* output, int starter = 0);
-void parseXStream(const char* input, const char* output, size_t mem=0, unsigned int vn=3);
+// Reads the edges of a SNAP text file, skipping comment lines
+
+class SnapReader {
+	public:
+		SnapReader(const char* input);
+		// reads the bytes of a block of memory that it does not own
+		SnapReader(const char* data, size_t size);
+		// reads only the bytes [begin, end) of an open file
+		SnapReader(const SnapReader& file, size_t begin, size_t end);
+		~SnapReader();
+		size_t getSize() const;
+		size_t nextLine(size_t pos) const;
+		bool nextEdge(vx& from, vx& to);
+
+	private:
+		int fd;
+		char* buf;
+		size_t size;
+		size_t index;
+		bool own;
+		bool nextNumber(vx& n);
+};
+
+void parseAdjacencyList(const char* input, const char* output, size_t mem = 0, unsigned threads = 1);
+void parseXStream(const char* input, const char* output, size_t mem=0, unsigned int vn=3,
+                  unsigned threads = 1);
 void convertToXStream(const char* input, const char* output);
-void convertToOPT(const char* input, const char* output);
+void convertToOPT(const char* input, const char* output, size_t mem = 0, unsigned threads = 1);
+vx ingest(const char* input, 
+          const char* output, 
+          bool snap, 
+          size_t mem = 0, 
+          unsigned int vn = 3, 
+          bool keepUndirected = false, 
+          unsigned threads = 1);
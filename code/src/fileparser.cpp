@@ -14,6 +14,7 @@
 #include <set>
 #include <thread>
 #include <cassert>
+#include <cerrno>
 #include <fcntl.h>
 #include <unistd.h>
 #include <sys/types.h>
@@ -24,6 +25,9 @@
 #include "parserutil.h"
 #include "degreehandler.h"
 #include "adjacencyhandler.h"
+#include "filebuffer.h"
+#include "reorder.h"
+#include "graphfile.h"
 
 using namespace std;
 
@@ -97,32 +101,74 @@ vx undirect(const char* input, const char* output)
 }
 
 
+// Orients the edges of the vertices in [lowVx, highVx). The counting pass
+// only finds how many edges survive, so that the scattering pass can write
+// them, together with the degree rows, directly to their final offsets.
+// Graphs produced by relabel() are ranked, and need no degree lookups;
+// neither does a degeneracy orientation, which compares the given order.
+
 class OrienterAdjacencyHandler : public AdjacencyHandler {
 	public:
 		OrienterAdjacencyHandler(const string input, 
-				                     const string output, 
-				                     size_t bufferSize = DEFAULT_BUF, 
-				                     bool fillstart = true, 
-				                     bool fillend = true)
-			: AdjacencyHandler(input, bufferSize)
+		                         DegreeHandler* deg, 
+		                         vx lowV, 
+		                         vx highV, 
+		                         OrientBy orientBy = ORIENT_DEGREE, 
+		                         const vx* ord = NULL, 
+		                         size_t bufferSize = DEFAULT_BUF)
+			: AdjacencyHandler(input, deg, bufferSize)
 		{
-			parser = new ParserUtil(output, bufferSize, fillstart, fillend);
+			by = orientBy;
+			order = ord;
+			lowVx = lowV;
+			highVx = highV;
+			buffSize = bufferSize;
+			adj = NULL;
+			degs = NULL;
+			edgeCount = 0;
+			maxDeg = 0;
 		}
 
-		OrienterAdjacencyHandler(const string input, 
-				                     const string output, 
-				                     DegreeHandler* deg, 
-				                     size_t bufferSize = DEFAULT_BUF, 
-				                     bool fillstart = true, 
-				                     bool fillend = true)
-			: AdjacencyHandler(input, deg, bufferSize)
+		void count(unsigned long long low, unsigned long long high)
 		{
-			parser = new ParserUtil(output, bufferSize, fillstart, fillend);
+			edgeCount = 0;
+			if (low < high)
+			{
+				processAdjacency(low, high);
+			}
 		}
 
-		~OrienterAdjacencyHandler()
+		void scatter(int adjFd, 
+		             int degFd, 
+		             unsigned long long offset, 
+		             unsigned long long low, 
+		             unsigned long long high)
 		{
-			delete parser;
+			adj = new OffsetFileBuffer(adjFd, offset*sizeof(vx), buffSize);
+			degs = new OffsetFileBuffer(degFd, 
+			                            ((unsigned long long) lowVx)*2*sizeof(vx), 
+			                            buffSize);
+			current = lowVx;
+			currentDeg = 0;
+			maxDeg = 0;
+
+			if (low < high)
+			{
+				processAdjacency(low, high);
+			}
+			writeDegrees(highVx);
+
+			adj->close();
+			degs->close();
+			delete adj;
+			delete degs;
+			adj = NULL;
+			degs = NULL;
+		}
+
+		unsigned long long getEdgeCount()
+		{
+			return edgeCount;
 		}
 
 		vx getMaxDegree()
@@ -131,8 +177,30 @@ class OrienterAdjacencyHandler : public AdjacencyHandler {
 		}
 
 	private:
-		ParserUtil* parser;
+		OffsetFileBuffer* adj;
+		OffsetFileBuffer* degs;
+		size_t buffSize;
+		unsigned long long edgeCount;
+		vx lowVx;
+		vx highVx;
+		vx current;
+		vx currentDeg;
 		vx maxDeg;
+		OrientBy by;
+		const vx* order;
+
+		// emits the rows of all vertices before upto, including empty ones
+		void writeDegrees(vx upto)
+		{
+			while (current < upto)
+			{
+				degs->addToBuffer(current);
+				degs->addToBuffer(currentDeg);
+				maxDeg = max(maxDeg, currentDeg);
+				currentDeg = 0;
+				++current;
+			}
+		}
 
 		virtual void overallSetUp(){}
 		virtual void processPhase(){}
@@ -140,31 +208,96 @@ class OrienterAdjacencyHandler : public AdjacencyHandler {
 		virtual void phaseSetUp(){}
 		virtual bool handleEdge(vx from, vx to, vx degree)
 		{
-			vx degFrom = degree;
-			vx degTo = deg->getDegree(to);
+			bool keep;
+			if (by == ORIENT_ID)
+			{
+				keep = from < to;
+			}
+			else if (by == ORIENT_DEGENERACY)
+			{
+				keep = order[from] < order[to];
+			}
+			else
+			{
+				vx degFrom = degree;
+				vx degTo = deg->getDegree(to);
+				keep = (degFrom < degTo) || (degFrom == degTo && from < to);
+			}
 
-			if ((degFrom < degTo) || (degFrom == degTo && from < to))
+			if (keep)
 			{
-				parser->addEdge(from, to);
+				if (adj == NULL)
+				{
+					++edgeCount;
+				}
+				else
+				{
+					writeDegrees(from);
+					++currentDeg;
+					adj->addToBuffer(to);
+				}
 			}
 			return true;
 		}
 
-		virtual void overallTearDown()
+		virtual void overallTearDown(){}
+};
+
+// Splits the vertices into threads ranges of roughly equal edges, storing
+// the first vertex and first edge offset of each range (plus the end).
+// Returns whether degrees never decrease with the id, i.e. the graph is
+// ranked as after relabel().
+static bool splitVertices(const string degFile, 
+                          unsigned long long adjsize, 
+                          unsigned threads, 
+                          vx* lowVx, 
+                          unsigned long long* lowEdge)
+{
+	DegreeHandler scan(degFile);
+	vx graphSize = (vx) scan.getGraphSize();
+	unsigned long long off = 0;
+	unsigned i = 0;
+	vx prev = 0;
+	bool ranked = true;
+	for (vx v = 0; v < graphSize; ++v)
+	{
+		while (i < threads && off >= adjsize/threads*i)
 		{
-			maxDeg = parser->getMaxDegree();
-			parser->close();
+			lowVx[i] = v;
+			lowEdge[i] = off;
+			++i;
 		}
-};
+		vx d = scan.getDegree(v);
+		ranked = ranked && prev <= d;
+		prev = d;
+		off += d;
+	}
 
-vx orient(const char* input, const char* output, size_t degMB, unsigned threads)
+	for (; i <= threads; ++i)
+	{
+		lowVx[i] = graphSize;
+		lowEdge[i] = off;
+	}
+	return ranked;
+}
+
+vx orient(const char* input, 
+          const char* output, 
+          size_t degMB, 
+          unsigned threads, 
+          OrientBy by)
 {
-	string degFile = getDegName(input);
+	if (threads == 0)
+	{
+		threads = 1;
+	}
+
+	string degFile = getDegFile(input);
 	DegreeHandler **randeg = new DegreeHandler *[threads];
 	DegreeHandler *deg = NULL;
 	bool random;
 	size_t degBufferSize = degMB*MB_TO_B*threads;
-	size_t size = getFileSize(degFile.c_str())/sizeof(vx);
+	size_t size = 2*getVertexCount(input);
 	if(degBufferSize == 0)
 		degBufferSize = size;
 	if (size <= degBufferSize)
@@ -178,158 +311,95 @@ vx orient(const char* input, const char* output, size_t degMB, unsigned threads)
 		random = true;
 		cout << "Random access degree handler" << endl;
 	}
-	if(threads == 1)
+
+	// split at vertex boundaries, so that each thread owns whole degree rows
+	size_t adjsize = getEdgeCount(input);
+	vx *lowVx = new vx[threads+1];
+	unsigned long long *lowEdge = new unsigned long long[threads+1];
+	if (splitVertices(degFile, adjsize, threads, lowVx, lowEdge) && by == ORIENT_DEGREE)
 	{
-		if(random)
-			deg = new NonSequentialDegreeHandler(degFile);
-		OrienterAdjacencyHandler handler(input, output, deg);
-		handler.processAdjacency(0, MAX_EDGES);
-		delete deg;
-		delete [] randeg;
-		return handler.getMaxDegree();
+		cout << "Degrees are sorted, orienting by id" << endl;
+		by = ORIENT_ID;
+	}
+
+	vx *order = NULL;
+	if (by == ORIENT_DEGENERACY)
+	{
+		order = new vx[lowVx[threads]];
+		vx degeneracy = degeneracyOrder(input, order);
+		cout << "Degeneracy is " << degeneracy << endl;
 	}
-	size_t adjsize = getFileSize(getAdjName(input).c_str())/sizeof(vx);
+
 	OrienterAdjacencyHandler **handlers = new OrienterAdjacencyHandler*[threads];
-	string filenames[threads];
 	thread *threadarr = new thread[threads];
-	for(unsigned i = 0; i < threads; i++)
+	unsigned i;
+	for(i = 0; i < threads; i++)
 	{
-		ostringstream tempname;
-		tempname << output << "-" << i;
-		filenames[i] = tempname.str();
 		if(random)
 		{
-			randeg[i] = new NonSequentialDegreeHandler(degFile);
-			handlers[i] = new OrienterAdjacencyHandler(input,
-					filenames[i].c_str(),
-					randeg[i],
-					DEFAULT_BUF,
-					i == 0 ? true : false,
-					i == threads-1 ? true : false);
-		}
-		else
-		{
-			handlers[i] = new OrienterAdjacencyHandler(input,
-					filenames[i].c_str(),
-					deg,
-					DEFAULT_BUF,
-					i == 0 ? true : false,
-					i == threads-1 ? true : false);
+			// only degree orientation needs random degree lookups
+			if(by != ORIENT_DEGREE)
+				randeg[i] = new DegreeHandler(degFile);
+			else
+				randeg[i] = new NonSequentialDegreeHandler(degFile);
 		}
-		threadarr[i] = thread(&OrienterAdjacencyHandler::processAdjacency,
-				handlers[i], adjsize/threads*i,
-				i == threads-1 ? adjsize : adjsize/threads*(i+1));
+		handlers[i] = new OrienterAdjacencyHandler(input,
+				random ? randeg[i] : deg,
+				lowVx[i],
+				lowVx[i+1],
+				by,
+				order);
+		threadarr[i] = thread(&OrienterAdjacencyHandler::count,
+				handlers[i], lowEdge[i], lowEdge[i+1]);
 	}
-	for(unsigned i = 0; i < threads; i++)
-	{
+	for(i = 0; i < threads; i++)
 		threadarr[i].join();
-		if(random)
-			delete randeg[i];
+
+	// prefix sum of the oriented edges gives each thread its output offset
+	unsigned long long *offsets = new unsigned long long[threads+1];
+	offsets[0] = 0;
+	for(i = 0; i < threads; i++)
+		offsets[i+1] = offsets[i] + handlers[i]->getEdgeCount();
+
+	int adjFd = open(getAdjName(output).c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	int degFd = open(getDegName(output).c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (adjFd < 0 || degFd < 0 ||
+	    ftruncate(adjFd, offsets[threads]*sizeof(vx)) ||
+	    ftruncate(degFd, ((unsigned long long) lowVx[threads])*2*sizeof(vx)))
+	{
+		cerr << "Error: could not create " << output << ": " << errno << endl;
+		exit(1);
 	}
-	delete[] randeg;
-	if(!random && deg != NULL)
-		delete deg;
+
+	for(i = 0; i < threads; i++)
+	{
+		threadarr[i] = thread(&OrienterAdjacencyHandler::scatter,
+				handlers[i], adjFd, degFd, offsets[i], lowEdge[i], lowEdge[i+1]);
+	}
+
 	vx maxDeg = 0;
-	for(unsigned i = 0; i < threads; i++)
+	for(i = 0; i < threads; i++)
 	{
-		vx Deg = handlers[i]->getMaxDegree();
-		if(Deg > maxDeg)
-			maxDeg = Deg;
+		threadarr[i].join();
+		maxDeg = max(maxDeg, handlers[i]->getMaxDegree());
 		delete handlers[i];
+		if(random)
+			delete randeg[i];
 	}
-	delete[] handlers;
-	FILE *files[threads];
-	FILE *outputfd;
-	size_t buffSize = degMB*MB_TO_B;
-	if(buffSize == 0)
-		buffSize = DEFAULT_BUF;
-	vx *buffer = new vx[buffSize];
-	outputfd = fopen(getAdjName(output).c_str(), "w");
-	for(unsigned i = 0; i < threads; i++) // append files to create .adj file
-	{
-		const char *name = getAdjName(filenames[i].c_str()).c_str();
-		files[i] = fopen(name, "r");
-		size_t size;
-		while(0 < (size = fread(buffer, sizeof(vx), buffSize, files[i])))
-		{
-			fwrite(buffer, sizeof(vx), size, outputfd);
-		}
-		fclose(files[i]);
-		remove(name);
-	}
-	fclose(outputfd);
-	// For the deg file, we need to check that the last line of the
-	// previous thread's file is not the same vertex as our first line;
-	// if it is then add them.
-	outputfd = fopen(getDegName(output).c_str(), "w");
-	vx next[2];
-	vx previous[2];
-	string degnames[threads];
-	degnames[0] = getDegName(filenames[0].c_str());
-	files[0] = fopen(degnames[0].c_str(), "r");
-	for(unsigned i = 0; i < threads; i++)
-	{
-		size_t filesize = getFileSize(degnames[i].c_str())/sizeof(vx);
-		if(!filesize) goto del;
-		size_t rem, size;
-		rem = filesize - ftell(files[i])/sizeof(vx) - 2;
-		while(0 < (size = fread(buffer, sizeof(vx), min(buffSize, rem),
-						files[i])))
-		{
-			fwrite(buffer, sizeof(vx), size, outputfd);
-			rem -= size;
-		}
-		assert(2 == fread(previous, sizeof(vx), 2, files[i]));
-		if(i != threads-1)
-		{
-tryagain:
-			degnames[i+1] = getDegName(filenames[i+1].c_str());
-			files[i+1] = fopen(degnames[i+1].c_str(), "r");
-			if(!fread(next, sizeof(vx), 2, files[i+1])) // empty file
-			{
-				if(i+1 == threads-1) { // no other .deg file left
-					fwrite(previous, sizeof(vx), 2, outputfd);
-					goto del;
-				}
-				fclose(files[i]); // else delete our file, increase i and try again
-				remove(degnames[i].c_str());
-				i++;
-				goto tryagain;
-			}
-			if(next[0] == previous[0]) {
-				next[1] += previous[1];
-				if(next[1] > maxDeg)
-					maxDeg = next[1]; // parser would not have noticed this
-				// because it split up in the threads
-			} else {
-				unsigned long index = 0;
-				buffer[index++] = previous[0];
-				buffer[index++] = previous[1];
-				previous[0]++;
-				// insert possible missing vertices with no edges
-				while(previous[0] < next[0])
-				{
-					if(index == buffSize)
-					{
-						fwrite(buffer, sizeof(vx), index, outputfd);
-						index = 0;
-					}
-					buffer[index++] = previous[0];
-					buffer[index++] = 0;
-					previous[0]++;
-				}
-				fwrite(buffer, sizeof(vx), index, outputfd);
-			}
-			fwrite(next, sizeof(vx), 2, outputfd);
-		} else
-			fwrite(previous, sizeof(vx), 2, outputfd);
 
-del:
-		fclose(files[i]);
-		remove(degnames[i].c_str());
-	}
-	fclose(outputfd);
-	delete[] buffer;
+	close(adjFd);
+	close(degFd);
+
+	if(deg != NULL)
+		delete deg;
+	if(order != NULL)
+		delete[] order;
+	delete[] randeg;
+	delete[] handlers;
+	delete[] threadarr;
+	delete[] offsets;
+	delete[] lowVx;
+	delete[] lowEdge;
 	return maxDeg;
 }
 
@@ -398,3 +468,338 @@ void orderNeighbors(const char* input, const char* output)
 	handler.processAdjacency(0, MAX_EDGES);
 }
 
+
+// Renumbers the vertices by increasing (degree, id), so that the order of
+// the new ids is also the orientation order, and the high-degree vertices
+// end up last. The new-to-original mapping is stored in the .map file.
+void relabel(const char* input, const char* output)
+{
+	DegreeHandler degs(getDegFile(input));
+	vx graphSize = (vx) degs.getGraphSize();
+	vx* degree = new vx[graphSize];
+	vx maxDeg = 0;
+	vx v;
+
+	for (v = 0; v < graphSize; ++v)
+	{
+		degree[v] = degs.getDegree(v);
+		maxDeg = max(maxDeg, degree[v]);
+	}
+
+	// counting sort by degree keeps vertices of equal degree in id order
+	unsigned long long* bucket = new unsigned long long[(size_t) maxDeg + 2];
+	fill(bucket, bucket + maxDeg + 2, 0);
+	for (v = 0; v < graphSize; ++v)
+	{
+		++bucket[degree[v]+1];
+	}
+	for (v = 0; v <= maxDeg; ++v)
+	{
+		bucket[v+1] += bucket[v];
+	}
+
+	vx* map = new vx[graphSize];
+	for (v = 0; v < graphSize; ++v)
+	{
+		map[bucket[degree[v]]++] = v;
+	}
+	delete[] bucket;
+	delete[] degree;
+
+	permute(input, output, map);
+	delete[] map;
+}
+
+// Writes the graph with vertex map[i] renamed to i, and stores map in the
+// .map file. Requires memory proportional to the number of vertices.
+void permute(const char* input, const char* output, const vx* map)
+{
+	DegreeHandler degs(getDegFile(input));
+	vx graphSize = (vx) degs.getGraphSize();
+	vx* rank = new vx[graphSize];
+	unsigned long long* offsets = new unsigned long long[graphSize+1];
+	vx maxDeg = 0;
+	vx v;
+
+	offsets[0] = 0;
+	for (v = 0; v < graphSize; ++v)
+	{
+		vx d = degs.getDegree(v);
+		offsets[v+1] = offsets[v] + d;
+		maxDeg = max(maxDeg, d);
+		rank[map[v]] = v;
+	}
+
+	FileBuffer mapOut(getMapName(output));
+	mapOut.addToBuffer((vx*) map, graphSize);
+	mapOut.close();
+
+	unsigned long long edges;
+	vx* adj = mapAdjacency(input, edges);
+	ParserUtil parser(output);
+	if (adj != NULL)
+	{
+		vx* list = new vx[maxDeg];
+		for (v = 0; v < graphSize; ++v)
+		{
+			vx old = map[v];
+			vx d = (vx) (offsets[old+1] - offsets[old]);
+			vx* neighbors = adj + offsets[old];
+			vx j;
+			for (j = 0; j < d; ++j)
+			{
+				list[j] = rank[neighbors[j]];
+			}
+			sort(list, list + d);
+			for (j = 0; j < d; ++j)
+			{
+				parser.addEdge(v, list[j]);
+			}
+		}
+		delete[] list;
+		unmapAdjacency(adj, edges);
+	}
+	parser.close();
+
+	delete[] rank;
+	delete[] offsets;
+}
+
+// Rewrites a binary listing of triangles in place, translating relabeled
+// ids back to the original ones through the given .map file
+void mapTriangles(const string triangles, const string mapName)
+{
+	size_t mapSize = getFileSize(mapName.c_str())/sizeof(vx);
+	vx* map = new vx[mapSize];
+	FILE* mapFd = fopen(mapName.c_str(), READ_FLAG);
+	if (mapFd == NULL || fread(map, sizeof(vx), mapSize, mapFd) != mapSize)
+	{
+		cerr << "Error: could not read " << mapName << endl;
+		exit(1);
+	}
+	fclose(mapFd);
+
+	FILE* fd = fopen(triangles.c_str(), "r+b");
+	if (fd == NULL)
+	{
+		cerr << "Error: could not open " << triangles << endl;
+		exit(1);
+	}
+
+	vx* buffer = new vx[DEFAULT_BUF];
+	unsigned long long pos = 0;
+	size_t size;
+	while (0 < (size = fread(buffer, sizeof(vx), DEFAULT_BUF, fd)))
+	{
+		size_t i;
+		for (i = 0; i < size; ++i)
+		{
+			buffer[i] = map[buffer[i]];
+		}
+		fseek64(fd, pos*sizeof(vx), SEEK_SET);
+		if (fwrite(buffer, sizeof(vx), size, fd) != size)
+		{
+			cerr << "Error: could not write " << triangles << endl;
+			exit(1);
+		}
+		pos += size;
+		fseek64(fd, pos*sizeof(vx), SEEK_SET);
+	}
+
+	fclose(fd);
+	delete[] buffer;
+	delete[] map;
+}
+
+// maps size bytes of fd at offset for writing, exiting on failure
+static char* mapForWriting(int fd, size_t size, unsigned long long offset)
+{
+	if (size == 0)
+	{
+		return NULL;
+	}
+
+	void* data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, offset);
+	if (data == MAP_FAILED)
+	{
+		cerr << "Error: could not map output: " << errno << endl;
+		exit(1);
+	}
+	return static_cast<char *> (data);
+}
+
+// true if the edges have no cycle, so that each triangle is found from exactly
+// one of its vertices: peels vertices with no remaining in-edges (Kahn)
+static bool isAcyclic(const unsigned long long* offsets, const vx* targets, vx vertices)
+{
+	vx* in = new vx[vertices]();
+	vx v;
+	unsigned long long i;
+	for (i = 0; i < offsets[vertices]; ++i)
+	{
+		if (targets[i] < vertices)
+		{
+			++in[targets[i]];
+		}
+	}
+	vx* ready = new vx[vertices];
+	vx count = 0, done = 0;
+	for (v = 0; v < vertices; ++v)
+	{
+		if (in[v] == 0)
+		{
+			ready[count++] = v;
+		}
+	}
+	while (done < count)
+	{
+		v = ready[done++];
+		for (i = offsets[v]; i < offsets[v+1]; ++i)
+		{
+			vx u = targets[i];
+			if (u < vertices && --in[u] == 0)
+			{
+				ready[count++] = u;
+			}
+		}
+	}
+	delete[] ready;
+	delete[] in;
+	return count == vertices;
+}
+
+void pack(const char* input, const char* output)
+{
+	GraphHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, GRAPH_MAGIC, sizeof(header.magic));
+	header.version = GRAPH_VERSION;
+	header.vxWidth = sizeof(vx);
+
+	DegreeHandler degs(getDegFile(input));
+	unsigned long long edges;
+	vx* adj = mapAdjacency(input, edges);
+	header.vertices = degs.getGraphSize();
+	header.edges = edges;
+
+	size_t offsetsSize = (header.vertices + 1)*sizeof(unsigned long long);
+	size_t targetsSize = header.edges*sizeof(vx);
+	header.offsetsStart = GRAPH_PAGE;
+	header.targetsStart = (GRAPH_PAGE + offsetsSize + GRAPH_PAGE - 1)/GRAPH_PAGE*GRAPH_PAGE;
+
+	int fd = open(output, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0 || ftruncate(fd, header.targetsStart + targetsSize) != 0)
+	{
+		cerr << "Error: could not create " << output << ": " << errno << endl;
+		exit(1);
+	}
+	unsigned long long* offsets = reinterpret_cast<unsigned long long *> 
+		(mapForWriting(fd, offsetsSize, header.offsetsStart));
+	vx* targets = reinterpret_cast<vx *> 
+		(mapForWriting(fd, targetsSize, header.targetsStart));
+
+	bool ranked = true, sorted = true;
+	header.minDeg = header.vertices > 0 ? MAX_EDGES : 0;
+	offsets[0] = 0;
+	vx v;
+	for (v = 0; v < header.vertices; ++v)
+	{
+		vx d = degs.getDegree(v);
+		offsets[v+1] = offsets[v] + d;
+		if (offsets[v+1] > header.edges)
+		{
+			cerr << "Error: the degrees do not match the adjacency of " << input << endl;
+			exit(1);
+		}
+
+		ranked = ranked && (v == 0 || offsets[v] - offsets[v-1] <= d);
+		header.maxDeg = max(header.maxDeg, (unsigned long long) d);
+		header.minDeg = min(header.minDeg, (unsigned long long) d);
+		header.isolated += d == 0;
+
+		const vx* list = adj + offsets[v];
+		vx j;
+		for (j = 0; j < d; ++j)
+		{
+			targets[offsets[v] + j] = list[j];
+			header.loops += list[j] == v;
+			sorted = sorted && (j == 0 || list[j-1] < list[j]);
+		}
+	}
+	if (offsets[header.vertices] != header.edges)
+	{
+		cerr << "Error: the degrees do not match the adjacency of " << input << endl;
+		exit(1);
+	}
+	unmapAdjacency(adj, edges);
+
+	// with sorted lists, look up the reverse of every edge
+	if (sorted)
+	{
+		unsigned long long reciprocal = 0;
+		for (v = 0; v < header.vertices; ++v)
+		{
+			unsigned long long i;
+			for (i = offsets[v]; i < offsets[v+1]; ++i)
+			{
+				vx u = targets[i];
+				reciprocal += u < header.vertices && 
+				              binary_search(targets + offsets[u], targets + offsets[u+1], v);
+			}
+		}
+		if (reciprocal == header.edges)
+		{
+			header.flags |= GRAPH_SYMMETRIC;
+		}
+		else if (reciprocal == 0 && header.loops == 0 && 
+		         isAcyclic(offsets, targets, header.vertices))
+		{
+			header.flags |= GRAPH_ORIENTED;
+		}
+	}
+	header.flags |= (sorted ? GRAPH_SORTED : 0) | (ranked ? GRAPH_RANKED : 0);
+
+	if (offsets != NULL)
+	{
+		munmap(offsets, offsetsSize);
+	}
+	if (targets != NULL)
+	{
+		munmap(targets, targetsSize);
+	}
+	if (pwrite(fd, &header, sizeof(header), 0) != (ssize_t) sizeof(header))
+	{
+		cerr << "Error: could not write " << output << ": " << errno << endl;
+		exit(1);
+	}
+	close(fd);
+
+	cout << header.vertices << " vertices, " << header.edges << " edges, max degree " 
+	     << header.maxDeg << endl;
+	cout << (sorted ? "sorted" : "unsorted") << (ranked ? ", ranked" : "") 
+	     << ((header.flags & GRAPH_SYMMETRIC) ? ", undirected" : "") 
+	     << ((header.flags & GRAPH_ORIENTED) ? ", oriented" : "") << endl;
+}
+
+void unpack(const char* input, const char* output)
+{
+	DegreeHandler degs(getDegFile(input));
+	FileBuffer deg(getDegName(output));
+	vx v, size = (vx) degs.getGraphSize();
+	for (v = 0; v < size; ++v)
+	{
+		deg.addToBuffer(v);
+		deg.addToBuffer(degs.getDegree(v));
+	}
+	deg.close();
+
+	unsigned long long edges;
+	vx* adj = mapAdjacency(input, edges);
+	FileBuffer out(getAdjName(output));
+	if (adj != NULL)
+	{
+		out.addToBuffer(adj, edges);
+	}
+	out.close();
+	unmapAdjacency(adj, edges);
+}
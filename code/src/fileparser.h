@@ -14,9 +14,20 @@
 
 // defines parser utilities
 
+// how orient() chooses the direction of each edge: by degree then id, by id
+// alone (for ranked graphs), or by a k-core degeneracy ordering, which bounds
+// the out-degree by the degeneracy
+enum OrientBy { ORIENT_DEGREE, ORIENT_ID, ORIENT_DEGENERACY };
 
 vx undirect(const char* input, const char* output);
 vx orient(const char* input, const char* output, size_t degMB = 0, 
-          unsigned threads = 1);
+          unsigned threads = 1, OrientBy by = ORIENT_DEGREE);
 void orderNeighbors(const char* input, const char* output);
+void relabel(const char* input, const char* output);
+void permute(const char* input, const char* output, const vx* map);
+void mapTriangles(const std::string triangles, const std::string mapName);
+
+// converts between the .deg/.adj pair and the single-file container
+void pack(const char* input, const char* output);
+void unpack(const char* input, const char* output);
 
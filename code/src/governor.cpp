@@ -0,0 +1,114 @@
+/*
+ * PDTL: Parallel and Distributed Triangle Listing for Massive Graphs
+ * Ilias Giechaskiel, George Panagopoulos, Eiko Yoneki
+ * 44th International Conference on Parallel Processing (ICPP), Beijing 2015
+ * 
+ * DOI: 10.1109/ICPP.2015.46
+ * 
+ * https://github.com/giech/pdtl
+ */
+
+#include "governor.h"
+
+using namespace std;
+
+MemoryGovernor::MemoryGovernor(unsigned long long totalMem, unsigned count)
+{
+	total = totalMem*1024*1024;
+	used = 0;
+	threads = count;
+}
+
+unsigned MemoryGovernor::join(unsigned long long bytes, const void* owner)
+{
+	lock_guard<mutex> lock(mtx);
+	// the buffers the owner kept are those of this handler now
+	map<const void*, unsigned long long>::iterator it = kept.find(owner);
+	if (it != kept.end())
+	{
+		used -= it->second;
+		kept.erase(it);
+	}
+	fixed.push_back(bytes);
+	window.push_back(0);
+	active.push_back(true);
+	owners.push_back(owner);
+	used += bytes;
+	return (unsigned) (fixed.size() - 1);
+}
+
+unsigned long long MemoryGovernor::lease(unsigned id, unsigned long long want)
+{
+	lock_guard<mutex> lock(mtx);
+	used -= window[id];
+	window[id] = 0;
+
+	unsigned long long buffers = 0;
+	unsigned running = 0;
+	size_t i;
+	for (i = 0; i < active.size(); ++i)
+	{
+		if (active[i])
+		{
+			buffers += fixed[i];
+			++running;
+		}
+	}
+	for (map<const void*, unsigned long long>::iterator it = kept.begin(); it != kept.end(); ++it)
+	{
+		buffers += it->second;
+	}
+	// threads between handlers, or yet to start one, come back for their
+	// shares, with buffers like those of the others
+	unsigned missing = threads > running ? threads - running : 0;
+	buffers += missing*(buffers/max(running, 1U));
+	unsigned long long windows = total > buffers ? total - buffers : 0;
+	unsigned long long fair = windows/max(running + missing, 1U);
+
+	// keep back what the others may still claim of their fair shares
+	unsigned long long reserve = missing*fair;
+	for (i = 0; i < active.size(); ++i)
+	{
+		if (active[i] && i != id && window[i] < fair)
+			reserve += fair - window[i];
+	}
+	unsigned long long free = total > used ? total - used : 0;
+	unsigned long long grant = max(min(fair, free), free > reserve ? free - reserve : 0);
+	grant = min(grant, want);
+
+	window[id] = grant;
+	used += grant;
+	return grant;
+}
+
+void MemoryGovernor::leave(unsigned id)
+{
+	lock_guard<mutex> lock(mtx);
+	used -= window[id];
+	if (owners[id] != NULL)
+	{
+		kept[owners[id]] = fixed[id];
+	}
+	else
+	{
+		used -= fixed[id];
+	}
+	window[id] = 0;
+	fixed[id] = 0;
+	active[id] = false;
+}
+
+void MemoryGovernor::retire(const void* owner)
+{
+	lock_guard<mutex> lock(mtx);
+	map<const void*, unsigned long long>::iterator it = kept.find(owner);
+	if (it != kept.end())
+	{
+		used -= it->second;
+		kept.erase(it);
+	}
+	if (threads > 0)
+	{
+		--threads;
+	}
+}
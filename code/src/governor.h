@@ -0,0 +1,52 @@
+/*
+ * PDTL: Parallel and Distributed Triangle Listing for Massive Graphs
+ * Ilias Giechaskiel, George Panagopoulos, Eiko Yoneki
+ * 44th International Conference on Parallel Processing (ICPP), Beijing 2015
+ * 
+ * DOI: 10.1109/ICPP.2015.46
+ * 
+ * https://github.com/giech/pdtl
+ */
+
+#pragma once
+
+#include "util.h"
+
+#include <mutex>
+#include <vector>
+#include <map>
+
+// Shares the memory of a process between the MGT handlers running in it.
+// Each handler holds its buffers for as long as it runs, and leases the
+// memory of its window anew at every phase, releasing the pages above its
+// lease. A handler is always granted its fair share of the memory left after
+// buffers, and more when other handlers do not use theirs. The fair shares
+// are kept for all the threads that will run handlers, joined or not, until
+// a thread retires, so the last handlers to run grow their windows as the
+// others finish. Buffers a thread keeps for its next handler stay counted.
+
+class MemoryGovernor {
+	public:
+		// in MB, for the given number of threads running handlers
+		MemoryGovernor(unsigned long long totalMem, unsigned threads = 0);
+		// a handler starts, holding fixed bytes of buffers, which its owner
+		// keeps after it leaves, if there is an owner
+		unsigned join(unsigned long long fixed, const void* owner = NULL);
+		// gives back the window of the handler, and returns how many bytes
+		// of the wanted ones its next window may use
+		unsigned long long lease(unsigned id, unsigned long long want);
+		void leave(unsigned id);
+		// a thread will run no more handlers, nor keep the buffers of its owner
+		void retire(const void* owner = NULL);
+
+	private:
+		std::mutex mtx;
+		unsigned long long total;
+		unsigned long long used;
+		std::vector<unsigned long long> fixed;
+		std::vector<unsigned long long> window;
+		std::vector<bool> active;
+		std::vector<const void*> owners;
+		std::map<const void*, unsigned long long> kept; // by idle owners
+		unsigned threads; // still to run handlers
+};
@@ -0,0 +1,139 @@
+/*
+ * PDTL: Parallel and Distributed Triangle Listing for Massive Graphs
+ * Ilias Giechaskiel, George Panagopoulos, Eiko Yoneki
+ * 44th International Conference on Parallel Processing (ICPP), Beijing 2015
+ * 
+ * DOI: 10.1109/ICPP.2015.46
+ * 
+ * https://github.com/giech/pdtl
+ */
+
+#include "graphfile.h"
+#include "degreehandler.h"
+#include "inputstream.h"
+
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+using namespace std;
+
+bool readGraphHeader(const string file, GraphHeader& header)
+{
+	FILE* fd = fopen(file.c_str(), READ_FLAG);
+	if (fd == NULL)
+	{
+		return false;
+	}
+
+	bool found = fread(&header, sizeof(GraphHeader), 1, fd) == 1 &&
+	             memcmp(header.magic, GRAPH_MAGIC, sizeof(header.magic)) == 0;
+	fclose(fd);
+	if (!found)
+	{
+		return false;
+	}
+
+	if (header.version != GRAPH_VERSION || header.vxWidth != sizeof(vx))
+	{
+		cerr << file << " is version " << header.version << " with " 
+		     << header.vxWidth << "-byte vertices, expected version " 
+		     << GRAPH_VERSION << " with " << sizeof(vx) << "-byte vertices" << endl;
+		exit(1);
+	}
+	return true;
+}
+
+bool isGraphContainer(const char* base)
+{
+	GraphHeader header;
+	return readGraphHeader(base, header);
+}
+
+string getDegFile(const char* base)
+{
+	return isGraphContainer(base) ? string(base) : getDegName(base);
+}
+
+string getAdjFile(const char* base)
+{
+	return isGraphContainer(base) ? string(base) : getAdjName(base);
+}
+
+// the container may also stand in for base.adj or base.deg on its own, as
+// when it is sent to clients under those names
+unsigned long long getAdjStart(const char* base)
+{
+	GraphHeader header;
+	return readGraphHeader(getAdjFile(base), header) ? header.targetsStart : 0;
+}
+
+unsigned long long getVertexCount(const char* base)
+{
+	GraphHeader header;
+	string degName = getDegFile(base);
+	if (readGraphHeader(degName, header))
+	{
+		return header.vertices;
+	}
+	return getFileSize(degName.c_str())/sizeof(vx)/2;
+}
+
+unsigned long long getEdgeCount(const char* base)
+{
+	GraphHeader header;
+	string adjName = getAdjFile(base);
+	if (readGraphHeader(adjName, header))
+	{
+		return header.edges;
+	}
+	if (InputStream::isCompressed(adjName))
+	{
+		// the degrees add up to the number of edges
+		DegreeHandler degs(getDegFile(base));
+		unsigned long long edges = 0;
+		vx v, size = (vx) degs.getGraphSize();
+		for (v = 0; v < size; ++v)
+		{
+			edges += degs.getDegree(v);
+		}
+		return edges;
+	}
+	return getFileSize(adjName.c_str())/sizeof(vx);
+}
+
+vx* mapAdjacency(const char* base, unsigned long long& edges)
+{
+	string adjName = getAdjFile(base);
+	unsigned long long start = getAdjStart(base);
+	edges = getEdgeCount(base);
+	if (edges == 0)
+	{
+		return NULL;
+	}
+
+	if (InputStream::isCompressed(adjName))
+	{
+		cerr << "Error: " << adjName << " is compressed, and cannot be mapped" << endl;
+		exit(1);
+	}
+
+	int fd = open(adjName.c_str(), O_RDONLY);
+	void* adj = mmap(nullptr, edges*sizeof(vx), PROT_READ, MAP_PRIVATE, fd, start);
+	close(fd);
+	if (adj == MAP_FAILED)
+	{
+		cerr << "Error: could not map " << adjName << ": " << errno << endl;
+		exit(1);
+	}
+	return static_cast<vx *> (adj);
+}
+
+void unmapAdjacency(vx* adj, unsigned long long edges)
+{
+	if (adj != NULL)
+	{
+		munmap(adj, edges*sizeof(vx));
+	}
+}
@@ -0,0 +1,62 @@
+/*
+ * PDTL: Parallel and Distributed Triangle Listing for Massive Graphs
+ * Ilias Giechaskiel, George Panagopoulos, Eiko Yoneki
+ * 44th International Conference on Parallel Processing (ICPP), Beijing 2015
+ * 
+ * DOI: 10.1109/ICPP.2015.46
+ * 
+ * https://github.com/giech/pdtl
+ */
+
+#pragma once
+
+#include "util.h"
+
+// Single-file graph container: a header page describing the graph, then the
+// CSR offsets (|V|+1 unsigned long long) and the targets (|E| vx), each
+// starting on a page boundary so that they can be mapped directly. Numbers
+// are stored in the byte order of the machine that packed the graph.
+//
+// Everywhere a graph base name is expected, a container file can be given
+// instead of the base.deg and base.adj pair.
+
+#define GRAPH_MAGIC "PDTLCSR"
+#define GRAPH_VERSION 1
+#define GRAPH_PAGE 4096
+
+#define GRAPH_SORTED 1    // every neighbor list is in increasing order
+#define GRAPH_RANKED 2    // degrees never decrease with the id
+#define GRAPH_SYMMETRIC 4 // every edge appears in both directions
+#define GRAPH_ORIENTED 8  // the edges form no cycle, not even a self-loop
+
+struct GraphHeader {
+	char magic[8];
+	unsigned int version;
+	unsigned int vxWidth;
+	unsigned long long vertices;
+	unsigned long long edges;
+	unsigned long long flags;
+	unsigned long long maxDeg;
+	unsigned long long minDeg;
+	unsigned long long isolated; // vertices with no neighbors
+	unsigned long long loops;
+	unsigned long long offsetsStart; // in bytes from the start of the file
+	unsigned long long targetsStart;
+};
+
+// false if file is not a container, and exits if it is one built for a
+// different vx width or version
+bool readGraphHeader(const std::string file, GraphHeader& header);
+bool isGraphContainer(const char* base);
+
+// the files holding the degrees and targets of a graph, and where the
+// targets start within theirs
+std::string getDegFile(const char* base);
+std::string getAdjFile(const char* base);
+unsigned long long getAdjStart(const char* base);
+unsigned long long getVertexCount(const char* base);
+unsigned long long getEdgeCount(const char* base);
+
+// maps the targets read-only, returning NULL for a graph without edges
+vx* mapAdjacency(const char* base, unsigned long long& edges);
+void unmapAdjacency(vx* adj, unsigned long long edges);
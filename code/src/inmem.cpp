@@ -11,6 +11,8 @@
 #include "util.h"
 #include "degreehandler.h"
 #include "adjacencyhandler.h"
+#include "fileparser.h"
+#include "graphfile.h"
 
 using namespace std;
 
@@ -162,9 +164,9 @@ int main(int argc, char* argv[])
 {
 	Timer t;
 	t.start();
-	if (argc != 4)
+	if (argc != 4 && argc != 5)
 	{
-		cerr << "Usage: " << argv[0] << " input output ordered" << endl;
+		cerr << "Usage: " << argv[0] << " input output ordered [relabeled]" << endl;
 		exit(1);
 	}
 
@@ -172,11 +174,26 @@ int main(int argc, char* argv[])
 	const char* output = atoi(argv[2]) != 0 ? "" : NULL;
 	bool ordered = atoi(argv[3]) != 0;
 
+	// a packed graph records whether it is oriented
+	GraphHeader header;
+	if (readGraphHeader(input, header))
+	{
+		ordered = (header.flags & GRAPH_ORIENTED) != 0;
+	}
+	bool relabeled = argc == 5 && atoi(argv[4]) != 0;
+
+
+	{
+		InMemAdjacencyHandler adj(input, ordered, output);
+		adj.processAdjacency(0, MAX_EDGES);
+		cout << "Adjacency pass finished in " << t.lap() <<endl;
+		cout << "Total number of triangles " << adj.getTriangleCount() << endl;
+	}
 
-	InMemAdjacencyHandler adj(input, ordered, output);
-	adj.processAdjacency(0, MAX_EDGES);
-	cout << "Adjacency pass finished in " << t.lap() <<endl;
-	cout << "Total number of triangles " << adj.getTriangleCount() << endl;
+	if (output != NULL && relabeled)
+	{
+		mapTriangles(getOutName(input.c_str()), getMapName(input.c_str()));
+	}
 	return 0;
 }
 
@@ -0,0 +1,218 @@
+/*
+ * PDTL: Parallel and Distributed Triangle Listing for Massive Graphs
+ * Ilias Giechaskiel, George Panagopoulos, Eiko Yoneki
+ * 44th International Conference on Parallel Processing (ICPP), Beijing 2015
+ * 
+ * DOI: 10.1109/ICPP.2015.46
+ * 
+ * https://github.com/giech/pdtl
+ */
+
+#include "inputstream.h"
+
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+using namespace std;
+
+static const unsigned char GZIP_MAGIC[] = {0x1F, 0x8B};
+static const unsigned char ZSTD_MAGIC[] = {0x28, 0xB5, 0x2F, 0xFD};
+
+// the tool that decompresses file, or NULL if it is not compressed
+static const char* getDecompressor(const string file)
+{
+	unsigned char magic[4] = {0, 0, 0, 0};
+	FILE* fd = fopen(file.c_str(), READ_FLAG);
+	if (fd == NULL)
+	{
+		return NULL;
+	}
+	size_t size = fread(magic, 1, sizeof(magic), fd);
+	fclose(fd);
+
+	if (size >= sizeof(GZIP_MAGIC) && !memcmp(magic, GZIP_MAGIC, sizeof(GZIP_MAGIC)))
+	{
+		return "gzip";
+	}
+	if (size >= sizeof(ZSTD_MAGIC) && !memcmp(magic, ZSTD_MAGIC, sizeof(ZSTD_MAGIC)))
+	{
+		return "zstd";
+	}
+	return NULL;
+}
+
+bool InputStream::isCompressed(const string file)
+{
+	return getDecompressor(file) != NULL;
+}
+
+InputStream::InputStream(const string file, size_t size)
+{
+	name = file;
+	bufferSize = max(size, (size_t) 1);
+	child = -1;
+
+	const char* tool = getDecompressor(file);
+	if (tool == NULL)
+	{
+		fd = open(file.c_str(), O_RDONLY);
+		if (fd < 0)
+		{
+			cerr << "Error: could not open " << file << ": " << errno << endl;
+			exit(1);
+		}
+	}
+	else
+	{
+		int pipes[2];
+		// close-on-exec, so that decompressors started by other threads do not
+		// hold the write end open; dup2 clears it on the output of the child
+		if (pipe2(pipes, O_CLOEXEC) != 0 || (child = fork()) < 0)
+		{
+			cerr << "Error: could not start " << tool << ": " << errno << endl;
+			exit(1);
+		}
+		if (child == 0)
+		{
+			dup2(pipes[1], STDOUT_FILENO);
+			close(pipes[0]);
+			close(pipes[1]);
+			execlp(tool, tool, "-dcq", file.c_str(), (char*) NULL);
+			cerr << "Error: could not run " << tool << ": " << errno << endl;
+			_exit(127);
+		}
+		close(pipes[1]);
+		fd = pipes[0];
+	}
+
+	buffers[0] = new char[bufferSize];
+	buffers[1] = new char[bufferSize];
+	sizes[0] = sizes[1] = 0;
+	ready[0] = ready[1] = false;
+	finished = false;
+	stopped = false;
+	current = 0;
+	pos = 0;
+	reader = thread(&InputStream::fill, this);
+}
+
+InputStream::~InputStream()
+{
+	{
+		lock_guard<mutex> lock(mtx);
+		stopped = true;
+	}
+	cv.notify_all();
+	reader.join();
+	close(fd);
+
+	if (child > 0)
+	{
+		int status;
+		waitpid(child, &status, 0);
+		// a stream abandoned early makes the tool fail on a closed pipe
+		if (finished && (!WIFEXITED(status) || WEXITSTATUS(status) != 0))
+		{
+			cerr << "Error: could not decompress " << name << endl;
+			exit(1);
+		}
+	}
+
+	delete[] buffers[0];
+	delete[] buffers[1];
+}
+
+// runs on the reader thread, alternating between the two buffers
+void InputStream::fill()
+{
+	unsigned b = 0;
+	while (true)
+	{
+		{
+			unique_lock<mutex> lock(mtx);
+			cv.wait(lock, [&]{ return stopped || !ready[b]; });
+			if (stopped)
+			{
+				return;
+			}
+		}
+
+		size_t size = 0;
+		ssize_t got = 0;
+		while (size < bufferSize && 
+		       (got = ::read(fd, buffers[b] + size, bufferSize - size)) > 0)
+		{
+			size += got;
+		}
+		if (got < 0)
+		{
+			cerr << "Error: could not read " << name << ": " << errno << endl;
+			exit(1);
+		}
+
+		{
+			lock_guard<mutex> lock(mtx);
+			sizes[b] = size;
+			ready[b] = true;
+		}
+		cv.notify_all();
+		if (size < bufferSize)
+		{
+			return;
+		}
+		b = 1 - b;
+	}
+}
+
+// waits for the current buffer, returning false at the end of the stream
+bool InputStream::next()
+{
+	unique_lock<mutex> lock(mtx);
+	if (pos == sizes[current] && ready[current])
+	{
+		// hand the consumed buffer back to the reader
+		if (sizes[current] < bufferSize)
+		{
+			finished = true;
+			return false;
+		}
+		ready[current] = false;
+		current = 1 - current;
+		pos = 0;
+		cv.notify_all();
+	}
+	cv.wait(lock, [&]{ return ready[current]; });
+	if (pos == sizes[current])
+	{
+		finished = true;
+		return false;
+	}
+	return true;
+}
+
+size_t InputStream::read(void* data, size_t size)
+{
+	char* out = static_cast<char *> (data);
+	size_t total = 0;
+	while (total < size && next())
+	{
+		size_t n = min(size - total, sizes[current] - pos);
+		memcpy(out + total, buffers[current] + pos, n);
+		pos += n;
+		total += n;
+	}
+	return total;
+}
+
+bool InputStream::skip(unsigned long long bytes)
+{
+	while (bytes > 0 && next())
+	{
+		size_t n = (size_t) min(bytes, (unsigned long long) (sizes[current] - pos));
+		pos += n;
+		bytes -= n;
+	}
+	return bytes == 0;
+}
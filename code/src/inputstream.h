@@ -0,0 +1,53 @@
+/*
+ * PDTL: Parallel and Distributed Triangle Listing for Massive Graphs
+ * Ilias Giechaskiel, George Panagopoulos, Eiko Yoneki
+ * 44th International Conference on Parallel Processing (ICPP), Beijing 2015
+ * 
+ * DOI: 10.1109/ICPP.2015.46
+ * 
+ * https://github.com/giech/pdtl
+ */
+
+#pragma once
+
+#include "util.h"
+
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <sys/types.h>
+
+// Reads a file from front to back. Files compressed with gzip or zstd are
+// recognised by their magic bytes, and decompressed by the gzip or zstd tool
+// in a child process. In both cases, a reader thread fills one buffer ahead
+// of the one being consumed.
+
+class InputStream {
+	public:
+		InputStream(const std::string file, size_t bufferSize = DEFAULT_BUF*sizeof(vx));
+		~InputStream();
+		// reads size bytes, or fewer only at the end of the stream
+		size_t read(void* data, size_t size);
+		bool skip(unsigned long long bytes);
+		static bool isCompressed(const std::string file);
+
+	private:
+		std::string name;
+		int fd;
+		pid_t child;
+		std::thread reader;
+		std::mutex mtx;
+		std::condition_variable cv;
+
+		char* buffers[2];
+		size_t sizes[2];
+		bool ready[2];
+		bool finished;
+		bool stopped;
+		unsigned current;
+		size_t pos;
+		size_t bufferSize;
+
+		void fill();
+		bool next();
+};
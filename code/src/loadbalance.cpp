@@ -14,17 +14,27 @@
 #include "adjacencyhandler.h"
 #include "parserutil.h"
 #include "fileparser.h"
+#include "graphfile.h"
+#include "inputstream.h"
 #include "mgt.h"
 #include "loadbalance.h"
 #include "assert.h"
 
+#include <thread>
+#include <fstream>
+#include <sstream>
+#include <numeric>
+#include <fcntl.h>
+
+using namespace std;
+
 ThreadInfo::ThreadInfo(const char *inputfile, 
                        const size_t& memory, 
 		                   const vx& maxdegree, 
 		                   const vx& numthreads)
 : input(inputfile), mem(memory), maxDeg(maxdegree), threads(numthreads) 
 {
-	graphSize = getFileSize(getAdjName(input.c_str()).c_str())/sizeof(vx);
+	graphSize = getEdgeCount(input.c_str());
 	chunks = NULL;
 	avdegree = NULL;
 }
@@ -37,6 +47,202 @@ ThreadInfo::~ThreadInfo()
 		delete[] avdegree;
 }
 
+void ThreadInfo::setWeights(const vector<double>& w)
+{
+	weights = w;
+	weights.resize(size, 1.0);
+}
+
+double ThreadInfo::share(unsigned j) const
+{
+	if (weights.empty())
+		return 1.0;
+	double sum = accumulate(weights.begin(), weights.end(), 0.0);
+	return weights[min(j, size - 1)]*size/sum;
+}
+
+// each thread intersects two fixed lists for a while, and a single thread
+// reads the file past the page cache
+Throughput measureThroughput(const string& name, unsigned threads)
+{
+	vector<unsigned long long> done(threads, 0);
+	vector<thread> workers;
+	unsigned t;
+	for (t = 0; t < threads; ++t)
+	{
+		workers.push_back(thread([&done, t]() {
+			vx first[BENCH_LIST], second[BENCH_LIST], out[BENCH_LIST];
+			vx i;
+			for (i = 0; i < BENCH_LIST; ++i)
+			{
+				first[i] = 2*i;
+				second[i] = 3*i;
+			}
+			Timer timer;
+			timer.start();
+			volatile vx found = 0;
+			unsigned long long n = 0;
+			do
+			{
+				for (i = 0; i < 64; ++i)
+				{
+					found += processIntersection(first, BENCH_LIST, second, BENCH_LIST, out);
+				}
+				n += 64;
+			} while (timer.total() < BENCH_TIME);
+			done[t] = n;
+		}));
+	}
+	for (t = 0; t < threads; ++t)
+	{
+		workers[t].join();
+	}
+
+	Throughput result;
+	result.intersections = accumulate(done.begin(), done.end(), 0ULL)/BENCH_TIME;
+
+	FILE* fd = fopen(name.c_str(), READ_FLAG);
+	if (fd == NULL)
+	{
+		cerr << "Could not open " << name << endl;
+		exit(1);
+	}
+	posix_fadvise(fileno(fd), 0, 0, POSIX_FADV_DONTNEED);
+	char* buf = new char[DEFAULT_BUF];
+	size_t bytes = 0, got;
+	Timer timer;
+	timer.start();
+	while (bytes < BENCH_SCAN && (got = fread(buf, 1, DEFAULT_BUF, fd)) > 0)
+	{
+		bytes += got;
+	}
+	double took = timer.total();
+	fclose(fd);
+	delete[] buf;
+	result.scan = took > 0 ? bytes/took : 0;
+	return result;
+}
+
+double edgeTime(const Throughput& t)
+{
+	// one intersection per edge, and the edge read at least once
+	double time = 0;
+	if (t.intersections > 0)
+		time += 1/t.intersections;
+	if (t.scan > 0)
+		time += sizeof(vx)/t.scan;
+	return time;
+}
+
+static bool sameRun(istringstream& line, 
+                    unsigned long long edges, 
+                    vx maxDeg, 
+                    size_t mem, 
+                    vx threads)
+{
+	unsigned long long e, d, m, t;
+	line >> e >> d >> m >> t;
+	return !line.fail() && e == edges && d == maxDeg && m == mem && t == threads;
+}
+
+bool ThreadInfo::cutFromProfile()
+{
+	ifstream in(getProfileName(input.c_str()));
+	vector<RangeProfile> ranges;
+	string text;
+	while (getline(in, text))
+	{
+		istringstream line(text);
+		RangeProfile r;
+		if (!sameRun(line, graphSize, maxDeg, mem, threads))
+			continue;
+		line >> r.low >> r.high >> r.total >> r.io >> r.softFaults >> r.hardFaults;
+		if (!line.fail())
+			ranges.push_back(r);
+	}
+	if (ranges.empty())
+		return false;
+
+	// the ranges of a run cover the whole graph
+	sort(ranges.begin(), ranges.end(), [](const RangeProfile& a, const RangeProfile& b) {
+		return a.low < b.low;
+	});
+	double total = 0;
+	unsigned long long prev = 0;
+	for (const RangeProfile& r : ranges)
+	{
+		if (r.low != prev || r.high < r.low)
+			break;
+		prev = r.high;
+		total += r.total;
+	}
+	if (prev != graphSize || total <= 0)
+	{
+		cout << "Ignoring incomplete profile " << getProfileName(input.c_str()) << endl;
+		return false;
+	}
+
+	// time is spread evenly over the edges of each range
+	unsigned j;
+	size_t i = 0;
+	double before = 0;
+	chunks[0] = 0;
+	for (j = 1; j < size; ++j)
+	{
+		double target = total*j/size;
+		if (!weights.empty())
+		{
+			target = total*accumulate(weights.begin(), weights.begin() + j, 0.0)
+				/accumulate(weights.begin(), weights.end(), 0.0);
+		}
+		while (i < ranges.size() - 1 && before + ranges[i].total < target)
+		{
+			before += ranges[i].total;
+			++i;
+		}
+		const RangeProfile& r = ranges[i];
+		double share = r.total > 0 ? min((target - before)/r.total, 1.0) : 1.0;
+		unsigned long long cut = r.low + (unsigned long long) (share*(r.high - r.low));
+		chunks[j] = max(chunks[j-1], min(cut, graphSize));
+	}
+	chunks[size] = graphSize;
+	cout << "Cut chunks from the profile of " << ranges.size() << " ranges" << endl;
+	return true;
+}
+
+void ThreadInfo::saveProfile(const vector<RangeProfile>& ranges) const
+{
+	string name = getProfileName(input.c_str());
+
+	// keep the runs with other parameters
+	vector<string> kept;
+	ifstream in(name);
+	string text;
+	while (getline(in, text))
+	{
+		istringstream line(text);
+		if (!sameRun(line, graphSize, maxDeg, mem, threads))
+			kept.push_back(text);
+	}
+	in.close();
+
+	ofstream out(name);
+	for (const string& k : kept)
+	{
+		out << k << "\n";
+	}
+	for (const RangeProfile& r : ranges)
+	{
+		out << graphSize << " " << maxDeg << " " << mem << " " << threads << " "
+		    << r.low << " " << r.high << " " << r.total << " " << r.io << " "
+		    << r.softFaults << " " << r.hardFaults << "\n";
+	}
+	if (!out)
+	{
+		cerr << "Could not write profile " << name << endl;
+	}
+}
+
 ThreadCoefficient::ThreadCoefficient(const char *inputfile,
 		                                 const size_t& memory, 
 		                                 const vx& maxdegree,
@@ -50,6 +256,8 @@ ThreadCoefficient::ThreadCoefficient(const char *inputfile,
 
 void ThreadCoefficient::loadbalance(void)
 {
+	if (cutFromProfile())
+		return;
 	unsigned long long diff = graphSize/size;
 	unsigned long long prev = 0;
 	for(unsigned long i = 0; i < size; i++)
@@ -71,6 +279,8 @@ ThreadLinear::ThreadLinear(const char *inputfile,
 
 void ThreadLinear::loadbalance(void)
 {
+	if (cutFromProfile())
+		return;
 	unsigned long long diff = graphSize/size;
 	unsigned long long prev = 0;
 	for(unsigned long i = 0; i < size; i++)
@@ -86,89 +296,496 @@ Volume::Volume(const char *inputfile,
 		           const vx& maxdegree,
 		           const vx& numthreads, 
 		           unsigned sizen, 
-		           const char *degrees)
+		           const char *degreefile)
 : ThreadInfo(inputfile, memory, maxdegree, numthreads),
-  ordeg(getDegName(inputfile).c_str()), 
-	nonordeg(getDegName(degrees).c_str())
+  degrees(degreefile)
 {
 	size = sizen;
 	chunks = new unsigned long long[size+1];
 	avdegree = new double[size];
+	vertices = (vx) getVertexCount(inputfile);
+	fill(cost, cost + COST_CLASSES, 0.0);
+	scanCost = 0;
+	fillCost = 0;
+}
+
+static inline unsigned degreeClass(vx d)
+{
+	unsigned c = 0;
+	while (d > 1 && c < COST_CLASSES - 1)
+	{
+		d >>= 1;
+		++c;
+	}
+	return c;
+}
+
+// predicted time of the chunk holding the out-edges of a vertex: one
+// intersection with its list per in-neighbor, plus loading the list itself
+inline double Volume::predict(vx outDeg, vx inDeg) const
+{
+	return ((double) inDeg + 1)*cost[degreeClass(outDeg)];
+}
+
+// first pass over a range of vertices, counting out-edges and picking the
+// vertices that hold the given edge offsets
+void Volume::scanRange(unsigned t, 
+                       const vector<unsigned long long>& targets, 
+                       vector<Sample>* found)
+{
+	DegreeHandler ordeg(getDegFile(input.c_str()));
+	DegreeHandler nonordeg(getDegFile(degrees.c_str()));
+	unsigned long long off = edgeStart[t];
+	size_t k = lower_bound(targets.begin(), targets.end(), off) - targets.begin();
+	vx v;
+	for (v = vertexStart[t]; v < vertexStart[t+1]; ++v)
+	{
+		vx d = ordeg.getDegree(v);
+		if (k < targets.size() && targets[k] < off + d)
+		{
+			Sample sample;
+			sample.vertex = v;
+			sample.offset = off;
+			sample.outDeg = d;
+			sample.inDeg = nonordeg.getDegree(v) - d;
+			found->push_back(sample);
+			while (k < targets.size() && targets[k] < off + d)
+			{
+				++k;
+			}
+		}
+		off += d;
+	}
+}
+
+// runs the real intersection kernel between the list of each sampled vertex
+// and the lists of sampled vertices of lower degree, standing in for its
+// in-neighbors. Samples come sorted by degree.
+void Volume::measure(const vx* adj, 
+                     const vector<Sample>& samples, 
+                     unsigned first, 
+                     vector<double>* times)
+{
+	vx* out = new vx[maxDeg + 1];
+	size_t i;
+	for (i = first; i < samples.size(); i += threads)
+	{
+		const Sample& s = samples[i];
+		vx* list = const_cast<vx*> (adj + s.offset);
+		size_t probes = max((size_t) 1, min((size_t) s.inDeg, (size_t) COST_PROBES));
+		Timer t;
+		t.start();
+		size_t rounds = 0, j;
+		volatile vx found = 0;
+		do
+		{
+			for (j = 0; j < probes; ++j)
+			{
+				const Sample& w = samples[(i/2 + j*COST_STRIDE) % (i + 1)];
+				found += processIntersection(list, s.outDeg, 
+				                             const_cast<vx*> (adj + w.offset), w.outDeg, out);
+			}
+			++rounds;
+		} while (t.total() < COST_MIN_TIME);
+		(*times)[i] = t.total()/(rounds*probes);
+	}
+	delete[] out;
+}
+
+// time per edge of the pass each phase makes over the graph, copying every
+// list and looking its members up in the vertices held in memory
+double Volume::measureScan(const vx* adj, unsigned long long edges)
+{
+	unsigned long long n = min(edges, (unsigned long long) COST_SCAN);
+	vx window = 1024;
+	vx* inds = new vx[window];
+	vx* nmem = new vx[window];
+	fill(inds, inds + window, (vx) UNINIT);
+	Timer t;
+	t.start();
+	volatile vx found = 0;
+	unsigned long long i;
+	for (i = 0; i < n; ++i)
+	{
+		vx to = adj[i];
+		nmem[i % window] = to;
+		if (to < window && inds[to] != UNINIT)
+		{
+			++found;
+		}
+	}
+	double time = t.total();
+	delete[] nmem;
+	delete[] inds;
+
+	// clearing fresh memory for the index, as the first phase does
+	unsigned long long* fresh = new unsigned long long[COST_SCAN];
+	t.start();
+	fill(fresh, fresh + COST_SCAN, (unsigned long long) found);
+	for (i = 0; i < COST_SCAN; i += 512)
+	{
+		found += fresh[i];
+	}
+	fillCost = t.total()/COST_SCAN;
+	delete[] fresh;
+	return n == 0 ? 0 : time/n;
+}
+
+// fits the time of one intersection per degree class from a sample of
+// vertices, weighted by edges so that hubs are represented
+void Volume::calibrate()
+{
+	unsigned t;
+	vector<unsigned long long> targets;
+	unsigned long long step = max(graphSize/COST_SAMPLES, (unsigned long long) 1);
+	unsigned long long o;
+	for (o = step/2; o < graphSize; o += step)
+	{
+		targets.push_back(o);
+	}
+
+	vector<vector<Sample> > found(threads);
+	vector<thread> workers;
+	for (t = 0; t < threads; ++t)
+	{
+		workers.push_back(thread(&Volume::scanRange, this, t, cref(targets), &found[t]));
+	}
+	vector<Sample> samples;
+	for (t = 0; t < threads; ++t)
+	{
+		workers[t].join();
+		samples.insert(samples.end(), found[t].begin(), found[t].end());
+	}
+	workers.clear();
+	sort(samples.begin(), samples.end(), [](const Sample& a, const Sample& b) {
+		return a.outDeg + a.inDeg < b.outDeg + b.inDeg;
+	});
+
+	// without the real lists, fall back to time proportional to the degree
+	unsigned c;
+	if (samples.empty() || InputStream::isCompressed(getAdjFile(input.c_str())))
+	{
+		for (c = 0; c < COST_CLASSES; ++c)
+		{
+			cost[c] = (double) (1ULL << c);
+		}
+		scanCost = 1;
+		fillCost = 1;
+		return;
+	}
+
+	unsigned long long edges;
+	vx* adj = mapAdjacency(input.c_str(), edges);
+	vector<double> times(samples.size());
+	for (t = 0; t < threads; ++t)
+	{
+		workers.push_back(thread(&Volume::measure, this, adj, cref(samples), t, &times));
+	}
+	for (t = 0; t < threads; ++t)
+	{
+		workers[t].join();
+	}
+	scanCost = measureScan(adj, edges);
+	unmapAdjacency(adj, edges);
+
+	unsigned counts[COST_CLASSES] = {0};
+	size_t i;
+	for (i = 0; i < samples.size(); ++i)
+	{
+		c = degreeClass(samples[i].outDeg);
+		cost[c] += times[i];
+		++counts[c];
+	}
+
+	// classes without samples scale linearly from the nearest sampled one
+	int last = -1;
+	for (c = 0; c < COST_CLASSES; ++c)
+	{
+		if (counts[c] > 0)
+		{
+			cost[c] /= counts[c];
+			last = c;
+		}
+	}
+	int next = -1;
+	for (c = COST_CLASSES; c-- > 0; )
+	{
+		if (counts[c] > 0)
+		{
+			next = c;
+		}
+		else if (next >= 0)
+		{
+			cost[c] = cost[next]/(double) (1ULL << (next - c));
+		}
+	}
+	for (c = last + 1; c < COST_CLASSES; ++c)
+	{
+		cost[c] = cost[c-1]*2;
+	}
+	cout << "Calibrated cost model on " << samples.size() << " vertices" << endl;
+}
+
+// second pass over a range of vertices, spreading the predicted time of each
+// vertex over its out-edges, and adding it up per interval of edges. The
+// first interval may be shared with the previous range, so it is kept apart.
+void Volume::costRange(unsigned t, 
+                       unsigned long long interval, 
+                       double* intervalCost, 
+                       vx* verat, 
+                       double* firstCost)
+{
+	DegreeHandler ordeg(getDegFile(input.c_str()));
+	DegreeHandler nonordeg(getDegFile(degrees.c_str()));
+	unsigned long long off = edgeStart[t];
+	unsigned long long first = off/interval;
+	*firstCost = 0;
+	vx v;
+	for (v = vertexStart[t]; v < vertexStart[t+1]; ++v)
+	{
+		vx d = ordeg.getDegree(v);
+		if (d == 0)
+		{
+			continue;
+		}
+		double perEdge = predict(d, nonordeg.getDegree(v) - d)/d;
+		unsigned long long end = off + d;
+		while (off < end)
+		{
+			unsigned long long index = off/interval;
+			unsigned long long upto = min(end, (index + 1)*interval);
+			double value = (upto - off)*perEdge;
+			if (index == first)
+			{
+				*firstCost += value;
+			}
+			else
+			{
+				intervalCost[index] += value;
+			}
+			if (upto == (index + 1)*interval || upto == graphSize)
+			{
+				verat[index] = upto == end ? v + 1 : v;
+			}
+			off = upto;
+		}
+	}
+}
+
+// predicted time of the chunk made of intervals [lo, hi): its intersections,
+// and a pass over the graph and a cleared index for each phase of the memory
+// it is given
+double Volume::chunkTime(const double* cumcost, 
+                         const vx* verat, 
+                         unsigned long long interval,
+                         unsigned long long lo, 
+                         unsigned long long hi) const
+{
+	double time = cumcost[hi-1] - (lo > 0 ? cumcost[lo-1] : 0);
+	unsigned long long edges = min(hi*interval, graphSize) - lo*interval;
+	vx from = lo > 0 ? verat[lo-1] : 0;
+	unsigned long long vers = max(verat[hi-1], from) - from + 1;
+	size_t chunkMem = (unsigned long long) mem*size*edges/graphSize;
+	unsigned long long index = MGTAdjacencyHandler::phaseVertices(chunkMem, 
+	                                                               maxDeg, 
+	                                                               (double) edges/vers, 
+	                                                               false);
+	unsigned long long phases = (vers + index - 1)/index;
+	return time + phases*(graphSize*scanCost + 2*index*fillCost);
+}
+
+// greedily cuts chunks of at most the given time, each as long as it can be,
+// and returns how many it took
+unsigned long long Volume::cutChunks(const double* cumcost, 
+                                     const vx* verat, 
+                                     unsigned long long interval, 
+                                     unsigned long long nointervals,
+                                     double limit, 
+                                     vector<unsigned long long>* cuts) const
+{
+	unsigned long long lo = 0, count = 0;
+	if (cuts != NULL)
+	{
+		cuts->assign(1, 0);
+	}
+	while (lo < nointervals)
+	{
+		// time grows with the length of the chunk
+		unsigned long long good = lo + 1, bad = nointervals + 1;
+		while (bad - good > 1)
+		{
+			unsigned long long mid = good + (bad - good)/2;
+			if (chunkTime(cumcost, verat, interval, lo, mid) <= limit*share(count))
+				good = mid;
+			else
+				bad = mid;
+		}
+		lo = good;
+		++count;
+		if (cuts != NULL)
+		{
+			cuts->push_back(lo);
+		}
+	}
+	return count;
+}
+
+// average degree of the vertices starting in each chunk
+void Volume::averageDegrees()
+{
+	DegreeHandler ordeg(getDegFile(input.c_str()));
+	vector<vx> counts(size, 0);
+	unsigned long long off = 0;
+	unsigned j = 0;
+	vx v;
+	for (v = 0; v < vertices; ++v)
+	{
+		while (j < size - 1 && off >= chunks[j+1])
+			++j;
+		++counts[j];
+		off += ordeg.getDegree(v);
+	}
+	for (j = 0; j < size; ++j)
+	{
+		avdegree[j] = (double) (chunks[j+1]-chunks[j])/(double)max(counts[j], (vx) 1);
+	}
 }
 
 void Volume::loadbalance()
 {
-	vx maxver = getFileSize(getDegName(input.c_str()).c_str())
-		/sizeof(vx)/2;
-	if(size == 1)
+	vx maxver = vertices;
+	if(size == 1 || graphSize == 0)
 	{
-		chunks[0] = 0;
-		chunks[1] = graphSize;
-		avdegree[0] = (double) graphSize/(double)maxver;
+		fill(chunks, chunks + size, 0);
+		chunks[size] = graphSize;
+		fill(avdegree, avdegree + size, 0.0);
+		avdegree[size-1] = (double) graphSize/(double)max(maxver, (vx) 1);
 		return;
 	}
-	unsigned long long interval = graphSize*(sizeof(unsigned long long)+sizeof(vx))/mem/1024/1024/threads + 1,
-		      nointervals = mem*threads*1024*1024/(sizeof(unsigned long long)+sizeof(vx));
-	unsigned long long *cumdegree = new unsigned long long[nointervals];
-	vx *verat = new vx[nointervals];
-	unsigned long long counter, index, total;
-	counter = total = index = 0;
-	for(vx ver = 0; ver < maxver; ver++)
-	{
-		unsigned long long fromDeg = ordeg.getDegree(ver);
-		if(!fromDeg) continue;
-		unsigned long long nonFromDeg = nonordeg.getDegree(ver),
-			      value = nonFromDeg - fromDeg + 1;
-		if(counter + fromDeg < interval)
-		{
-			counter += fromDeg;
-			total += fromDeg*value;
-		} else
-		{
-			total += (interval - counter)*value;
-			cumdegree[index] = total;
-			verat[index] = ver;
-			index++;
-			fromDeg = fromDeg + counter - interval;
-			while(fromDeg >= interval)
+
+	if (cutFromProfile())
+	{
+		averageDegrees();
+		return;
+	}
+
+	// split the vertices evenly between threads, and find where their
+	// out-edges start
+	unsigned t;
+	vertexStart.assign(threads + 1, maxver);
+	edgeStart.assign(threads + 1, graphSize);
+	for (t = 0; t < threads; ++t)
+	{
+		vertexStart[t] = (vx) ((unsigned long long) maxver*t/threads);
+	}
+	vector<thread> workers;
+	for (t = 0; t < threads; ++t)
+	{
+		workers.push_back(thread([this, t]() {
+			DegreeHandler ordeg(getDegFile(input.c_str()));
+			unsigned long long sum = 0;
+			vx v;
+			for (v = vertexStart[t]; v < vertexStart[t+1]; ++v)
 			{
-				total += interval*value;
-				cumdegree[index] = total;
-				verat[index] = ver;
-				index++;
-				fromDeg -= interval;
+				sum += ordeg.getDegree(v);
 			}
-			counter = fromDeg;
-			total += fromDeg*value;
+			edgeStart[t+1] = sum;
+		}));
+	}
+	edgeStart[0] = 0;
+	for (t = 0; t < threads; ++t)
+	{
+		workers[t].join();
+		edgeStart[t+1] += edgeStart[t];
+	}
+	workers.clear();
+
+	calibrate();
+
+	unsigned long long interval = graphSize*(sizeof(unsigned long long)+sizeof(vx))/mem/1024/1024/threads + 1;
+	unsigned long long nointervals = (graphSize + interval - 1)/interval;
+	double *cumcost = new double[nointervals];
+	vx *verat = new vx[nointervals];
+	double *firstCost = new double[threads];
+	fill(cumcost, cumcost + nointervals, 0.0);
+	fill(verat, verat + nointervals, maxver);
+	for (t = 0; t < threads; ++t)
+	{
+		workers.push_back(thread(&Volume::costRange, 
+		                              this, 
+		                              t, 
+		                              interval, 
+		                              cumcost, 
+		                              verat, 
+		                              &firstCost[t]));
+	}
+	for (t = 0; t < threads; ++t)
+	{
+		workers[t].join();
+		if (edgeStart[t] < graphSize)
+		{
+			cumcost[edgeStart[t]/interval] += firstCost[t];
 		}
 	}
+	delete[] firstCost;
 
-	if(counter)
+	unsigned long long i;
+	for (i = 1; i < nointervals; ++i)
 	{
-		cumdegree[index] = total;
-		verat[index] = maxver;
-		index++;
+		cumcost[i] += cumcost[i-1];
 	}
-	nointervals = index;
 
-	unsigned long long perthread = total/size;
-	unsigned long long i = 0, j, prev = 0, prevTot = 0;
+	// the smallest time within which the chunks can be cut
+	double low = 0, high = chunkTime(cumcost, verat, interval, 0, nointervals);
+	for (t = 0; t < size; ++t)
+	{
+		high = max(high, high/share(t));
+	}
+	unsigned r;
+	for (r = 0; r < COST_ROUNDS; ++r)
+	{
+		double mid = (low + high)/2;
+		if (cutChunks(cumcost, verat, interval, nointervals, mid, NULL) <= size)
+			high = mid;
+		else
+			low = mid;
+	}
+	vector<unsigned long long> cuts;
+	cutChunks(cumcost, verat, interval, nointervals, high, &cuts);
+
+	// use up any chunks left by halving the slowest
+	while (cuts.size() < (size_t) size + 1)
+	{
+		size_t slowest = 0;
+		double worst = -1;
+		for (i = 0; i + 1 < cuts.size(); ++i)
+		{
+			double time = chunkTime(cumcost, verat, interval, cuts[i], cuts[i+1])/share(i);
+			if (cuts[i+1] - cuts[i] > 1 && time > worst)
+			{
+				worst = time;
+				slowest = i;
+			}
+		}
+		if (worst < 0)
+		{
+			cuts.push_back(nointervals);
+			continue;
+		}
+		cuts.insert(cuts.begin() + slowest + 1, (cuts[slowest] + cuts[slowest+1])/2);
+	}
+
+	unsigned long long j;
 	vx prevver = 0;
 	chunks[0] = 0;
-	for(j = 1; j < size; j++)
+	for(j = 1; j <= size; j++)
 	{
-		for(; i < nointervals; i++)
-			if(cumdegree[i] >= prevTot + perthread)
-				break;
-		prev = i*interval;
-		prevTot = cumdegree[i];
-		chunks[j] = prev;
-		avdegree[j-1] = (double) (chunks[j]-chunks[j-1])/(double)(verat[i]-prevver);
-		prevver = verat[i];
+		chunks[j] = min(cuts[j]*interval, graphSize);
+		vx ver = j == size ? maxver : max(verat[cuts[j] - 1], prevver);
+		avdegree[j-1] = (double) (chunks[j]-chunks[j-1])/(double)max(ver - prevver, (vx) 1);
+		prevver = ver;
 	}
 	chunks[size] = graphSize;
-	avdegree[size-1] = (double) (chunks[size]-chunks[size-1])/(double)(maxver-prevver);
 	delete[] verat;
-	delete[] cumdegree;
+	delete[] cumcost;
 }
-
@@ -18,6 +18,8 @@
 #include "fileparser.h"
 #include "mgt.h"
 
+#include <vector>
+
 // Code that is responsible for load-balancing of graph to each core
 
 class ThreadInfo
@@ -38,6 +40,10 @@ public:
   inline vx getthreads() const { return threads; }
   inline unsigned long long getgraphsize() const { return graphSize; }
   inline const double *getavdegree() const { return avdegree; }
+  // records the time of each range of this run in the profile of the graph
+  void saveProfile(const std::vector<RangeProfile>& ranges) const;
+  // relative speed of the thread running each chunk, equal by default
+  void setWeights(const std::vector<double>& w);
 
 protected:
   std::string input;
@@ -48,8 +54,33 @@ protected:
   unsigned long long *chunks;
   double *avdegree;
   unsigned size;
+  std::vector<double> weights;
+
+  // fraction of the average chunk that chunk j should get
+  double share(unsigned j) const;
+
+  // cuts chunks of equal time as measured by a previous run with the same
+  // parameters, if the graph has a profile of one
+  bool cutFromProfile();
+};
+
+#define BENCH_TIME 0.2
+#define BENCH_LIST 256
+#define BENCH_SCAN (64 << 20)
+
+// how fast a machine intersects lists and reads its copy of the graph
+
+struct Throughput
+{
+  double intersections; // per second, over all threads
+  double scan;          // bytes per second
 };
 
+// scan is the file to read, normally the adjacency file of the graph
+Throughput measureThroughput(const std::string& scan, unsigned threads);
+// time of one edge at the given throughput, used to weight machines
+double edgeTime(const Throughput& t);
+
 class ThreadCoefficient : public ThreadInfo
 {
 public:
@@ -71,6 +102,20 @@ public:
   virtual void loadbalance();
 };
 
+#define COST_CLASSES 40
+#define COST_SAMPLES 512
+#define COST_PROBES 16
+#define COST_STRIDE 7
+#define COST_MIN_TIME 0.0002
+#define COST_SCAN (1 << 20)
+#define COST_ROUNDS 60
+
+// Cuts chunks of equal predicted time. Each thread scans a range of vertices,
+// and the time of an intersection is calibrated per out-degree class by
+// running the real kernel on a sample of vertices. A chunk also pays for a
+// pass over the graph, and for clearing its index, in each phase its memory
+// share forces.
+
 class Volume : public ThreadInfo
 {
 public:
@@ -80,5 +125,35 @@ public:
   virtual void loadbalance();
 
 private:
-  DegreeHandler ordeg, nonordeg;
+  struct Sample {
+    vx vertex;
+    unsigned long long offset;
+    vx outDeg;
+    vx inDeg;
+  };
+
+  std::string degrees;
+  vx vertices;
+  double cost[COST_CLASSES];
+  double scanCost;
+  double fillCost;
+  std::vector<vx> vertexStart;
+  std::vector<unsigned long long> edgeStart;
+
+  void averageDegrees();
+
+  double predict(vx outDeg, vx inDeg) const;
+  void calibrate();
+  void scanRange(unsigned t, const std::vector<unsigned long long>& targets, 
+                 std::vector<Sample>* found);
+  void measure(const vx* adj, const std::vector<Sample>& samples, unsigned first,
+               std::vector<double>* times);
+  double measureScan(const vx* adj, unsigned long long edges);
+  void costRange(unsigned t, unsigned long long interval, double* intervalCost, 
+                 vx* verat, double* firstCost);
+  double chunkTime(const double* cumcost, const vx* verat, unsigned long long interval,
+                   unsigned long long lo, unsigned long long hi) const;
+  unsigned long long cutChunks(const double* cumcost, const vx* verat, 
+                               unsigned long long interval, unsigned long long nointervals,
+                               double limit, std::vector<unsigned long long>* cuts) const;
 };
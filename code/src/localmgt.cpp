@@ -12,6 +12,7 @@
 #include "util.h"
 #include "networkutil.h"
 #include "fileparser.h"
+#include "graphfile.h"
 #include "threadpool.h"
 
 using namespace std;
@@ -24,7 +25,7 @@ int main(int argc, char** argv) {
 
 	if (argc < 6)
 	{
-		cerr << "Usage: " << argv[0] << " filename maxdeg output mem instances" << endl;
+		cerr << "Usage: " << argv[0] << " filename maxdeg output mem instances [relabeled]" << endl;
 		return 1;
 	}
 
@@ -44,6 +45,16 @@ int main(int argc, char** argv) {
 
 	vx count = (vx) atoi(argv[5]);
 
+	// graph produced by parser.bin relabel or reorder
+	bool relabeled = argc >= 7 && atoi(argv[6]) != 0;
+
+	// a packed graph that is already oriented records its max degree
+	GraphHeader header;
+	if (maxDeg == 0 && readGraphHeader(orig, header) && (header.flags & GRAPH_ORIENTED))
+	{
+		maxDeg = (vx) header.maxDeg;
+		cout << "Graph is oriented, max degree " << maxDeg << endl;
+	}
 
 	if (maxDeg == 0)
 	{
@@ -61,18 +72,23 @@ int main(int argc, char** argv) {
 	cout << "Load balancing took " << t.lap() << endl;
 	ThreadPool calc(output, info);
 	cout << "Calculating took " << t.lap() << endl;
+	info.saveProfile(calc.getprofiles());
 
 	cout << "Triangle num: " << calc.getcount() << endl;
 
 	if (output)
 	{
 		auto outName = getOutName(base);
-		concatenate(outName, info.getsize());
-		for (unsigned long i = 0; i < info.getsize(); ++i)
+		concatenate(outName, calc.getparts());
+		for (unsigned long i = 0; i < calc.getparts(); ++i)
 		{
 			string name = getName(outName, i);
 			remove(name.c_str());
 		}
+		if (relabeled)
+		{
+			mapTriangles(outName, getMapName(orig));
+		}
 	}
 
 	cout << "Concatenation took " << t.lap() << endl;
@@ -15,6 +15,7 @@
 #include "adjacencyhandler.h"
 #include "parserutil.h"
 #include "fileparser.h"
+#include "graphfile.h"
 #include "mgt.h"
 
 using namespace std;
@@ -24,23 +25,21 @@ using namespace std;
 	                                         unsigned long long totalMem, 
 	                                         const char* output, 
 	                                         double avdegree, 
-	                                         unsigned int bufferSize)
-: AdjacencyHandler(input, bufferSize)
+	                                         unsigned int bufferSize,
+	                                         WindowArena* arena)
+: AdjacencyHandler(input, bufferSize, arena)
 {
-	unsigned long long remainingMem = totalMem*MB_TO_B;
 	const char* input_str = input.c_str();
 
-	string adjName = getAdjName(input_str);
-	adjFd = fopen(adjName.c_str(), READ_FLAG);
+	adjFd = arena != NULL ? arena->getFile(ARENA_SCAN, adjName) 
+	                      : fopen(adjName.c_str(), READ_FLAG);
+	adjStream = NULL;
 	vxBufferSize = bufferSize;
-	vxBuffer = new vx[vxBufferSize];
+	vxBuffer = allocate<vx>(ARENA_VXBUFFER, vxBufferSize);
 
 	maxDeg = mxDg;
-	nmem = new vx[maxDeg];
-	nmemplus = new vx[maxDeg];
-
-	// adj and deg for super + vxBuf + variables
-	unsigned long long bufferTotals = 2*bufferSize + vxBufferSize + 2*maxDeg + 100;
+	nmem = allocate<vx>(ARENA_NMEM, maxDeg);
+	nmemplus = allocate<vx>(ARENA_NMEMPLUS, maxDeg);
 
 	if (output != NULL)
 	{
@@ -50,8 +49,7 @@ using namespace std;
 			outName = getOutName(input_str);
 		}
 		b = new FileBuffer(outName, bufferSize);
-		intersection = new vx[maxDeg];
-		bufferTotals += bufferSize + maxDeg;
+		intersection = allocate<vx>(ARENA_INTERSECTION, maxDeg);
 	}
 	else
 	{
@@ -59,40 +57,78 @@ using namespace std;
 		b = NULL;
 	}
 
-	if(bufferTotals > remainingMem)
-		remainingMem = 0;
-	else
-		remainingMem -= bufferTotals;
-	if(remainingMem > totalMem*MB_TO_B)
-		remainingMem = 0;
-	unsigned long long index = (unsigned long long)(remainingMem/(avdegree+2)); // for each vertex we have avdegree
-	if(index == 0)
-		index = 1;
+	unsigned long long index = phaseVertices(totalMem, 
+	                                         maxDeg, 
+	                                         avdegree, 
+	                                         output != NULL, 
+	                                         bufferSize);
 	sizeIndex = index;
-	inds = new unsigned long long[2*sizeIndex];
+	inds = allocate<unsigned long long>(ARENA_INDS, 2*sizeIndex);
 
 	sizeEdges = avdegree*index;
 	if(sizeEdges == 0)
 		sizeEdges = 1;
-	edges = new vx[sizeEdges];
+	edges = allocate<vx>(ARENA_EDGES, sizeEdges);
+
+	governor = NULL;
+	governorId = 0;
+	avgDegree = avdegree;
+	indsCapacity = 2*sizeIndex;
+	edgesCapacity = sizeEdges;
 }
 
 MGTAdjacencyHandler::~MGTAdjacencyHandler()
 {
-	delete[] nmem;
-	delete[] nmemplus;
-	delete[] vxBuffer;
-	delete[] inds;
-	delete[] edges;
+	if (arena == NULL)
+	{
+		delete[] nmem;
+		delete[] nmemplus;
+		delete[] vxBuffer;
+		delete[] inds;
+		delete[] edges;
+		delete[] intersection;
+		fclose(adjFd);
+	}
 
 	if (b != NULL)
 	{
-		delete[] intersection;
 		b->close();
 		delete b;
 	}
 
-	fclose(adjFd);
+	delete adjStream;
+}
+
+unsigned long long MGTAdjacencyHandler::phaseVertices(unsigned long long totalMem, 
+                                                      vx maxDeg, 
+                                                      double avdegree, 
+                                                      bool output, 
+                                                      unsigned int bufferSize)
+{
+	unsigned long long remainingMem = totalMem*MB_TO_B;
+	unsigned long long buffers = bufferTotals(maxDeg, output, bufferSize);
+
+	if(buffers > remainingMem)
+		remainingMem = 0;
+	else
+		remainingMem -= buffers;
+	unsigned long long index = (unsigned long long)(remainingMem/(avdegree+2)); // for each vertex we have avdegree
+	if(index == 0)
+		index = 1;
+	return index;
+}
+
+unsigned long long MGTAdjacencyHandler::bufferTotals(vx maxDeg, 
+                                                     bool output, 
+                                                     unsigned int bufferSize)
+{
+	// adj and deg for super + vxBuf + variables
+	unsigned long long buffers = 3*bufferSize + 2*maxDeg + 100;
+	if (output)
+	{
+		buffers += bufferSize + maxDeg;
+	}
+	return buffers;
 }
 
 unsigned long long MGTAdjacencyHandler::getTriangleCount()
@@ -115,6 +151,40 @@ void MGTAdjacencyHandler::overallSetUp()
 	triangleCount = 0;
 	newLowIndex = 0;
 	t.start();
+	if (governor != NULL)
+	{
+		governorId = governor->join(bufferTotals(maxDeg, b != NULL, vxBufferSize)*sizeof(vx), arena);
+	}
+}
+
+// leases a window big enough for the edges left, or as much of it as the
+// governor allows, grows the arrays if they are too small for it, and gives
+// back the pages of the arrays past it
+void MGTAdjacencyHandler::resizeWindow()
+{
+	double perVertex = (avgDegree + 2)*sizeof(vx);
+	unsigned long long left = rangeHigh > rangeNext ? rangeHigh - rangeNext : 0;
+	unsigned long long want = (unsigned long long) ((left/max(avgDegree, 1.0) + 1)*perVertex);
+	unsigned long long grant = governor->lease(governorId, want);
+
+	sizeIndex = max((unsigned long long) (grant/perVertex), 1ULL);
+	sizeEdges = max((unsigned long long) (avgDegree*sizeIndex), 1ULL);
+	if (2*sizeIndex > indsCapacity)
+	{
+		if (arena == NULL)
+			delete[] inds;
+		inds = allocate<unsigned long long>(ARENA_INDS, 2*sizeIndex);
+		indsCapacity = 2*sizeIndex;
+	}
+	if (sizeEdges > edgesCapacity)
+	{
+		if (arena == NULL)
+			delete[] edges;
+		edges = allocate<vx>(ARENA_EDGES, sizeEdges);
+		edgesCapacity = sizeEdges;
+	}
+	releasePages(inds, 2*sizeIndex*sizeof(unsigned long long), indsCapacity*sizeof(unsigned long long));
+	releasePages(edges, sizeEdges*sizeof(vx), edgesCapacity*sizeof(vx));
 }
 
 void MGTAdjacencyHandler::processPhase()
@@ -165,6 +235,10 @@ void MGTAdjacencyHandler::processPhase()
 
 void MGTAdjacencyHandler::phaseSetUp()
 {
+	if (governor != NULL)
+	{
+		resizeWindow();
+	}
 	fill(inds, inds + 2*sizeIndex, UNINIT);
 
 	lastFrom = UNINIT;
@@ -174,7 +248,16 @@ void MGTAdjacencyHandler::phaseSetUp()
 
 void MGTAdjacencyHandler::overallTearDown()
 {
-
+	if (governor != NULL)
+	{
+		// the window the arena keeps for the next handler is not in use
+		if (arena != NULL)
+		{
+			releasePages(inds, 0, indsCapacity*sizeof(unsigned long long));
+			releasePages(edges, 0, edgesCapacity*sizeof(vx));
+		}
+		governor->leave(governorId);
+	}
 }
 
 bool MGTAdjacencyHandler::handleEdge(vx from, vx to, vx degree)
@@ -202,11 +285,40 @@ bool MGTAdjacencyHandler::handleEdge(vx from, vx to, vx degree)
 
 void MGTAdjacencyHandler::updateBuffer(bool rewind)
 {
+	if (rewind && compressed)
+	{
+		// every pass decompresses the adjacency again
+		if (arrival != NULL)
+		{
+			arrival->waitFor(0, MAX_EDGES);
+		}
+		delete adjStream;
+		adjStream = new InputStream(adjName);
+	}
+	else if (rewind)
+	{
+		fseek64(adjFd, adjStart, SEEK_SET);
+	}
 	if (rewind)
 	{
-		fseek64(adjFd, 0, SEEK_SET);
+		scanOffset = 0;
+	}
+
+	if (adjStream != NULL)
+	{
+		remainingEdges = (vx) (adjStream->read(vxBuffer, vxBufferSize*sizeof(vx))/sizeof(vx));
 	}
-	remainingEdges = (vx) fread(vxBuffer, sizeof(vx), vxBufferSize, adjFd);
+	else
+	{
+		// the scan follows the transfer of the file, if it is still arriving
+		if (arrival != NULL)
+		{
+			arrival->waitFor(adjStart + scanOffset*sizeof(vx), 
+			                 adjStart + (scanOffset + vxBufferSize)*sizeof(vx));
+		}
+		remainingEdges = (vx) fread(vxBuffer, sizeof(vx), vxBufferSize, adjFd);
+	}
+	scanOffset += remainingEdges;
 	bufferOffset = 0;
 }
 
@@ -261,16 +373,24 @@ void MGTAdjacencyHandler::timedProcessAdjacency(unsigned long long low,
 	getrusage(RUSAGE_THREAD, &usage);
 	double before_user = TIMEVAL_TO_SEC(usage.ru_utime);
 	double before_system = TIMEVAL_TO_SEC(usage.ru_stime);
+	long before_soft = usage.ru_minflt;
+	long before_hard = usage.ru_majflt;
 	processAdjacency(low, high);
 	getrusage(RUSAGE_THREAD, &usage);
 	double total = t.total();
+	profile.low = low;
+	profile.high = rangeHigh;
+	profile.total = total;
+	profile.io = total -
+		(TIMEVAL_TO_SEC(usage.ru_utime) - before_user +
+		 TIMEVAL_TO_SEC(usage.ru_stime) - before_system);
+	profile.softFaults = usage.ru_minflt - before_soft;
+	profile.hardFaults = usage.ru_majflt - before_hard;
 	cout << "Thread exit; triangles = " << triangleCount
 		<< ", total time = " << total
-		<< ", approx. I/O time = " << total -
-		(TIMEVAL_TO_SEC(usage.ru_utime) - before_user +
-		 TIMEVAL_TO_SEC(usage.ru_stime) - before_system)
+		<< ", approx. I/O time = " << profile.io
 		<< ", soft page faults " << usage.ru_minflt
 		<< ", hard page faults " << usage.ru_majflt
-		<< ", edges " << low << " to " << high << endl;
+		<< ", edges " << low << " to " << rangeHigh << endl;
 }
 
@@ -11,6 +11,18 @@
 #pragma once
 #include "util.h"
 #include "adjacencyhandler.h"
+#include "governor.h"
+
+// measurements of a range of edges, as written to a profile
+
+struct RangeProfile {
+  unsigned long long low;
+  unsigned long long high;
+  double total;
+  double io;
+  long softFaults;
+  long hardFaults;
+};
 
 // class which implements the MGT algorithm with our modifications
 
@@ -21,12 +33,27 @@ class MGTAdjacencyHandler : public AdjacencyHandler {
                       unsigned long long totalMem, 
                       const char* output, 
                       double avdegree, 
-                      unsigned int bufferSize = DEFAULT_BUF);
+                      unsigned int bufferSize = DEFAULT_BUF,
+                      WindowArena* arena = NULL);
   virtual ~MGTAdjacencyHandler();
   unsigned long long getTriangleCount();
   void timedProcessAdjacency(unsigned long long low, unsigned long long high);
+  inline const RangeProfile& getProfile() const { return profile; }
+  // size the window of each phase with memory leased from the governor
+  inline void setGovernor(MemoryGovernor* g) { governor = g; }
+  // vertices whose edges fit in memory in one phase
+  static unsigned long long phaseVertices(unsigned long long totalMem, 
+                                          vx maxDeg, 
+                                          double avdegree, 
+                                          bool output, 
+                                          unsigned int bufferSize = DEFAULT_BUF);
+  // memory (in vx) of everything but the window
+  static unsigned long long bufferTotals(vx maxDeg, 
+                                         bool output, 
+                                         unsigned int bufferSize = DEFAULT_BUF);
  private:
   FILE* adjFd;
+  InputStream* adjStream;
   vx maxDeg;
 
   vx* nmem;
@@ -41,6 +68,7 @@ class MGTAdjacencyHandler : public AdjacencyHandler {
 
   vx bufferOffset;
   vx remainingEdges;
+  unsigned long long scanOffset; // edges read by the scan of this phase
 	
   unsigned long long triangleCount;
   vx lastFrom;
@@ -57,6 +85,13 @@ class MGTAdjacencyHandler : public AdjacencyHandler {
   unsigned long long sizeEdges;
   unsigned long long curEdge;
   Timer t;
+  RangeProfile profile;
+
+  MemoryGovernor* governor;
+  unsigned governorId;
+  double avgDegree;
+  unsigned long long indsCapacity;
+  unsigned long long edgesCapacity;
 
   virtual void overallSetUp();
   virtual void processPhase();
@@ -65,6 +100,13 @@ class MGTAdjacencyHandler : public AdjacencyHandler {
   virtual void overallTearDown();
 
 
+  // from the arena if there is one, and the heap otherwise
+  template<class T> T* allocate(ArenaSlot slot, size_t count)
+  {
+    return arena != NULL ? arena->get<T>(slot, count) : new T[count];
+  }
+
+  void resizeWindow();
   void createVertexStructures(vx from);
   void updateBuffer(bool rewind);
   vx getIndex(vx from);
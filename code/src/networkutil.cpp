@@ -9,8 +9,12 @@
  */
 
 #include "networkutil.h"
-#include "filebuffer.h"
 #include <fstream>
+#include <fcntl.h>
+#include <netinet/tcp.h>
+#include <sys/mman.h>
+#include <sys/sendfile.h>
+#include <poll.h>
 
 #define RECV_FLAG MSG_WAITALL
 #define SEND_FLAG 0
@@ -18,8 +22,12 @@
 #define SHIFT 32
 #define MASK 0xFFFFFFFF
 
+// socket buffers, and the most a single call moves while transferring files
+#define SOCKET_BUFFER (4 << 20)
+#define TRANSFER_BLOCK (64ULL << 20)
+#define ARRIVAL_BLOCK (1ULL << 20)
+
 
-const unsigned long long BUFFER_SIZE = DEFAULT_BUF; //2048;
 using namespace std;
 
 // Since the following 2 functions are not standard, we used
@@ -69,130 +77,251 @@ vx toNetwork(vx u)
 }
 
 
+void setNoDelay(int sock)
+{
+	int on = 1;
+	if (setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on)) < 0)
+	{
+		cerr << strerror(errno) << ": Error with setting TCP_NODELAY" << endl;
+	}
+}
+
+bool waitReadable(int sock, double seconds)
+{
+	struct pollfd p;
+	p.fd = sock;
+	p.events = POLLIN;
+	p.revents = 0;
+	// a closed or failed connection counts as readable, for the read to fail
+	return poll(&p, 1, (int) (seconds*1000)) != 0;
+}
+
 vx readVx(int socket)
 {
 	vx ans;
 
 	if (recv(socket, (char*) &ans, sizeof(ans), RECV_FLAG) != sizeof(ans))
 	{
-		cout << "ERROR RECEIVING" << endl;
+		cerr << "Error receiving" << endl;
 		return 0; // TODO: error
 	}
 
-	vx temp =  fromNetwork(ans);
-	cout << "READ " << temp << endl; 
-	return temp;
+	return fromNetwork(ans);
 }
 
 void writeVx(int socket, vx v)
 {
 	vx temp = toNetwork(v);
 
-	cout << "WRITING " << v << endl;
-
 	if (send(socket, (char*) &temp, sizeof(temp), SEND_FLAG) != sizeof(temp))
 	{
 		// TODO: error
-		cout << "ERROR SENDING" << endl;
+		cerr << "Error sending" << endl;
 	}
 }
 
 unsigned long long readULL(int sock)
 {
 	unsigned long long tri;
-	if (recv(sock, (char*) &tri, sizeof(tri), RECV_FLAG) != sizeof(tri))
+	if (!readULL(sock, tri))
 	{
-		cout << "Error: " << errno << endl;
 		return 0; // TODO: error
 	}
 
-	unsigned long long temp = fromNetworkULL(tri);
-	cout << "READ " << temp << endl;
-	return temp;
+	return tri;
 }
 
-void writeULL(int sock, unsigned long long tri)
+bool readULL(int sock, unsigned long long& u)
+{
+	unsigned long long tri;
+	if (recv(sock, (char*) &tri, sizeof(tri), RECV_FLAG) != sizeof(tri))
+	{
+		cerr << "Error: " << errno << endl;
+		return false;
+	}
+
+	u = fromNetworkULL(tri);
+	return true;
+}
+
+bool writeULL(int sock, unsigned long long tri)
 {
-	cout << "WRITING " << tri << endl;
 	unsigned long long temp = toNetworkULL(tri);
 	if (send(sock, (char*) &temp, sizeof(temp), SEND_FLAG) != sizeof(temp))
 	{
-		cout << "Error: " << errno << endl;
-		// TODO error
+		cerr << "Error: " << errno << endl;
+		return false;
+	}
+	return true;
+}
+
+void setBufferSizes(int sock)
+{
+	int size = SOCKET_BUFFER;
+	if (setsockopt(sock, SOL_SOCKET, SO_SNDBUF, &size, sizeof(size)) < 0 ||
+	    setsockopt(sock, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size)) < 0)
+	{
+		cerr << strerror(errno) << ": Error with setting socket buffers" << endl;
+	}
+}
+
+bool readFile(int socket, string out)
+{
+	FileSegment whole;
+	whole.offset = 0;
+	if (!readULL(socket, whole.length)) // in bytes
+	{
+		return false;
 	}
+	return readFileSegments(socket, out, vector<FileSegment>(1, whole), NULL);
 }
 
-void readFile(int socket, string out)
+// The file is sized up front and mapped, so that recv writes the
+// data straight into the page cache without an intermediate buffer
+bool readFileSegments(int socket, string out, 
+                      const vector<FileSegment>& order, 
+                      FileArrival* arrival)
 {
-	vx* buf = new vx[BUFFER_SIZE]; /* Temporary buffer */
+	unsigned long long fileSize = 0, total = 0, received = 0;
+	size_t i;
+	for (i = 0; i < order.size(); ++i)
+	{
+		fileSize = max(fileSize, order[i].offset + order[i].length);
+		total += order[i].length;
+	}
+	const char* out_str = out.c_str();
 
-	int length;
-	unsigned long long fileSize = readULL(socket);
-	unsigned long long remaining = fileSize;
+	// only this transfer fails, as a client runs other jobs alongside
+	int fd = open(out_str, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0 || ftruncate(fd, (off_t) fileSize) < 0)
+	{
+		cerr << strerror(errno) << ": Error creating " << out << endl;
+		if (fd >= 0)
+		{
+			close(fd);
+		}
+		if (arrival != NULL)
+		{
+			arrival->finish(false);
+		}
+		return false;
+	}
 
-	FileBuffer b(out);
-	while ((length = recv(socket, (char*) buf, (int) (min(BUFFER_SIZE, remaining)*sizeof(vx)), RECV_FLAG)) > 0)
+	char* data = NULL;
+	if (fileSize > 0)
 	{
-		/*
-		   int remainder = length %sizeof(vx);
-		   while (remainder != 0)
-		   {
-		   int r = recv(socket, ((char*) buf) + length, 4 - remainder, 0);
-		   if (r <= 0)
-		   {
-		   cout << "RECV ERROR: " << r << endl;
-		   cout << "PROBLEM!!!" << endl;
-		   }
-		   length += r;
-		   remainder -= r;
-		   }
-		 */
+		data = (char*) mmap(NULL, fileSize, PROT_WRITE, MAP_SHARED, fd, 0);
+		if (data == MAP_FAILED)
+		{
+			cerr << strerror(errno) << ": Error mapping " << out << endl;
+			close(fd);
+			if (arrival != NULL)
+			{
+				arrival->finish(false);
+			}
+			return false;
+		}
+		madvise(data, fileSize, MADV_SEQUENTIAL);
+	}
+	if (arrival != NULL && order.empty())
+	{
+		arrival->start();
+	}
 
-		if (length % sizeof(vx) != 0)
+	// readers following the transfer are woken up every block
+	unsigned long long block = arrival != NULL ? ARRIVAL_BLOCK : TRANSFER_BLOCK;
+	for (i = 0; i < order.size(); ++i)
+	{
+		unsigned long long done = 0;
+		while (done < order[i].length)
 		{
-			cout << "PROBLEM WITH FLAG" << endl;
+			size_t want = (size_t) min(order[i].length - done, block);
+			ssize_t length = recv(socket, data + order[i].offset + done, want, RECV_FLAG);
+			if (length <= 0)
+			{
+				cerr << "Connection closed after " << received << " of " 
+				     << total << " bytes of " << out << endl;
+				break;
+			}
+			done += length;
+			received += length;
+			if (arrival != NULL)
+			{
+				arrival->advance(length);
+			}
 		}
+		if (done < order[i].length)
+		{
+			break;
+		}
+		// the first segment holds the header of the file, which readers look
+		// at before anything else
+		if (i == 0 && arrival != NULL)
+		{
+			arrival->start();
+		}
+	}
 
-		vx size = (vx) length/sizeof(vx);
-		remaining -= size;
-		b.addToBuffer(buf, size);
+	if (data != NULL)
+	{
+		munmap(data, fileSize);
+	}
+	close(fd);
+	if (arrival != NULL)
+	{
+		arrival->finish(received == total);
 	}
+	return received == total;
+}
 
-	b.close();
-	delete[] buf;
+bool writeFile(int sock, std::string in)
+{
+	return writeFile(sock, in, getFileSize(in.c_str()));
 }
 
-void writeFile(int sock, std::string in)
+bool writeFile(int sock, std::string in, unsigned long long length)
 {
-	const char* in_str = in.c_str();
-	FILE* fd = fopen(in_str, READ_FLAG);
-	vx* buf = new vx[BUFFER_SIZE];
-	unsigned long long filesize = getFileSize(in_str);
-	writeULL(sock, filesize/sizeof(vx));
+	FileSegment whole;
+	whole.offset = 0;
+	whole.length = length;
+	// in bytes, as compressed files need not hold whole words
+	return writeULL(sock, whole.length) && 
+	       writeFileSegments(sock, in, vector<FileSegment>(1, whole));
+}
 
-	size_t size;
-	while (0 < (size = fread(buf, sizeof(vx), BUFFER_SIZE, fd)))
+// sendfile moves the pages from the page cache to the socket without
+// copying them through user space
+bool writeFileSegments(int sock, std::string in, const vector<FileSegment>& order)
+{
+	const char* in_str = in.c_str();
+	int fd = open(in_str, O_RDONLY);
+	if (fd < 0)
 	{
-		vx total = 0;
-		int sendSize = (int) size*sizeof(vx);
+		cerr << strerror(errno) << ": Error opening " << in << endl;
+		return false;
+	}
 
-		while (sendSize > 0)
+	size_t i;
+	for (i = 0; i < order.size(); ++i)
+	{
+		off_t offset = (off_t) order[i].offset;
+		unsigned long long end = order[i].offset + order[i].length;
+		posix_fadvise(fd, offset, order[i].length, POSIX_FADV_SEQUENTIAL);
+		while ((unsigned long long) offset < end)
 		{
-			int written = send(sock, ((char*) buf) + total, sendSize, SEND_FLAG);
+			size_t want = (size_t) min(end - offset, TRANSFER_BLOCK);
+			ssize_t written = sendfile(sock, fd, &offset, want);
 			if (written <= 0)
 			{
-				//todo something
-				cout << "SEND ERROR " << written << endl;
-				cout << "PROBLEM!" << endl;
+				cerr << strerror(errno) << ": Error sending " << in << endl;
+				close(fd);
+				return false;
 			}
-
-			sendSize -= written;
-			total += written;
 		}
 	}
 
-	fclose(fd);
-	delete[] buf;
+	close(fd);
+	return true;
 }
 
 void concatenate(string baseName, int count)
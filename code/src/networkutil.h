@@ -10,10 +10,12 @@
 
 #pragma once
 #include "util.h"
+#include "arrival.h"
 
 // Utility class for common networking functions
 
 #include <thread>
+#include <vector>
 
 #include <arpa/inet.h>
 #include <sys/socket.h>
@@ -21,14 +23,40 @@
 #include <netdb.h>
 #include <unistd.h>
 
+unsigned long long toNetworkULL(unsigned long long u);
+unsigned long long fromNetworkULL(unsigned long long u);
+
+// sends small messages as soon as they are written
+void setNoDelay(int sock);
+// enlarges the socket buffers, to keep long file transfers streaming
+void setBufferSizes(int sock);
+// false if nothing arrived on the socket within the time
+bool waitReadable(int sock, double seconds);
+
 vx readVx(int sock);
 void writeVx(int sock, vx v);
 
 unsigned long long readULL(int sock);
-void writeULL(int sock, unsigned long long tri);
-
-void readFile(int sock, std::string out);
-void writeFile(int sock, std::string in);
+// false if the connection failed before the number arrived
+bool readULL(int sock, unsigned long long& u);
+bool writeULL(int sock, unsigned long long tri);
+
+// false if the file could not be created, or the connection closed before
+// the whole of it arrived
+bool readFile(int sock, std::string out);
+// false if the file could not be read or sent in full
+bool writeFile(int sock, std::string in);
+// only the first length bytes of the file, received as a whole file
+bool writeFile(int sock, std::string in, unsigned long long length);
+// the segments of the file, sent in the given order and without a size;
+// the receiver creates the file at its full size first, and reports the
+// progress of the transfer to arrival, if given, which starts once the first
+// segment is in
+bool readFileSegments(int sock, std::string out, 
+                      const std::vector<FileSegment>& order, 
+                      FileArrival* arrival);
+bool writeFileSegments(int sock, std::string in, 
+                       const std::vector<FileSegment>& order);
 
 void concatenate(std::string baseName, int count);
 std::string getName(std::string baseName, int i);
@@ -10,6 +10,7 @@
 
 #include "fileparser.h"
 #include "fileconverter.h"
+#include "reorder.h"
 #include "util.h"
 
 // Main for calling the fileparser and fileconverter utilities
@@ -19,18 +20,22 @@ using namespace std;
 void printUsage(char* name)
 {
 	cerr << "Usage: " << name << " method input output [extravalues]" << endl;
-	cerr << "Method can only be one of parse, convert, order, undirect, orient" << endl;
-	cerr << "Undirect and order do not take extra values." << endl;
-	cerr << "parse snap/xstream [mem] [2/3 for xstream]" << endl;
-	cerr << "convert opt/xstream" << endl;
-	cerr << "orient [mem] [numthreads]" << endl;
+	cerr << "Method can only be one of parse, convert, order, undirect, orient, relabel, reorder, ingest, pack, unpack" << endl;
+	cerr << "Undirect, order, relabel, pack and unpack do not take extra values." << endl;
+	cerr << "parse snap [mem] [numthreads]" << endl;
+	cerr << "parse xstream [mem] [2/3] [numthreads]" << endl;
+	cerr << "ingest snap/xstream [mem] [keep undirected] [2/3 for xstream] [numthreads]" << endl;
+	cerr << "convert opt [mem] [numthreads]" << endl;
+	cerr << "convert xstream" << endl;
+	cerr << "orient [mem] [numthreads] [degree/id/degeneracy]" << endl;
+	cerr << "reorder bfs/rcm/degree/community" << endl;
 }
 
 int main(int argc, char* argv[])
 {
 	Timer t;
 	t.start();
-	if (argc < 4 || argc > 7)
+	if (argc < 4 || argc > 9)
 	{
 		printUsage(argv[0]);
 		return 1;
@@ -53,7 +58,12 @@ int main(int argc, char* argv[])
 	  
 	  if (!strcmp(type, "snap"))
 	  {
-	    parseAdjacencyList(input, output, mem);
+	    if (argc >= 7)
+	    {
+	      threads = atoi(argv[6]);
+	    }
+	  
+	    parseAdjacencyList(input, output, mem, threads);
 	  }
 	  else if (!strcmp(type, "xstream"))
 	  {
@@ -62,8 +72,12 @@ int main(int argc, char* argv[])
 	    {
 	      vn = atoi(argv[6]);
 	    }
+	    if (argc >= 8)
+	    {
+	      threads = atoi(argv[7]);
+	    }
 	  
-	    parseXStream(input, output, mem, vn);
+	    parseXStream(input, output, mem, vn, threads);
 	  }
 	  else
 	  {
@@ -71,6 +85,36 @@ int main(int argc, char* argv[])
 		  return 1;
 	  } 
 	}
+	else if (!strcmp(method, "ingest"))
+	{
+	  if (argc < 5 || (strcmp(argv[4], "snap") && strcmp(argv[4], "xstream")))
+	  {
+	    printUsage(argv[0]);
+		  return 1;
+	  }
+	  bool snap = !strcmp(argv[4], "snap");
+	  bool keep = false;
+	  unsigned int vn = 3;
+	  if (argc >= 6)
+	  {
+	    mem = atoll(argv[5]);
+	  }
+	  if (argc >= 7)
+	  {
+	    keep = atoi(argv[6]) != 0;
+	  }
+	  if (argc >= 8)
+	  {
+	    vn = atoi(argv[7]);
+	  }
+	  if (argc == 9)
+	  {
+	    threads = atoi(argv[8]);
+	  }
+
+	  vx maxDeg = ingest(input, output, snap, mem, vn, keep, threads);
+	  cout << "Max degree is " << maxDeg << endl;
+	}
 	else if (!strcmp(method, "order"))
 	{
 		orderNeighbors(input, output);
@@ -79,16 +123,49 @@ int main(int argc, char* argv[])
 	{
 		undirect(input, output);
 	}
+	else if (!strcmp(method, "relabel"))
+	{
+		relabel(input, output);
+	}
+	else if (!strcmp(method, "pack"))
+	{
+		pack(input, output);
+	}
+	else if (!strcmp(method, "unpack"))
+	{
+		unpack(input, output);
+	}
+	else if (!strcmp(method, "reorder"))
+	{
+	  if (argc < 5 || !reorder(input, output, argv[4]))
+	  {
+	    printUsage(argv[0]);
+		  return 1;
+	  }
+	}
 	else if (!strcmp(method, "orient"))
 	{
+	  OrientBy by = ORIENT_DEGREE;
 	  if (argc >= 5)
 	  {
 		  mem = atoll(argv[4]);
 	  }
-	  if (argc == 6)
+	  if (argc >= 6)
 		  threads = atoi(argv[5]);
+	  if (argc == 7)
+	  {
+		  if (!strcmp(argv[6], "id"))
+			  by = ORIENT_ID;
+		  else if (!strcmp(argv[6], "degeneracy"))
+			  by = ORIENT_DEGENERACY;
+		  else if (strcmp(argv[6], "degree"))
+		  {
+			  printUsage(argv[0]);
+			  return 1;
+		  }
+	  }
 	
-		vx maxDeg = orient(input, output, mem, threads);
+		vx maxDeg = orient(input, output, mem, threads, by);
 		cout << "Max degree is " << maxDeg << endl;
 	}
 	else if (!strcmp(method, "convert"))
@@ -96,7 +173,17 @@ int main(int argc, char* argv[])
 	  const char* type = argv[4];
 	  if (!strcmp(type, "opt"))
 	  {
-	    convertToOPT(input, output);
+	    size_t mem = 0;
+	    unsigned threads = 1;
+	    if (argc > 5)
+	    {
+	      mem = atoll(argv[5]);
+	    }
+	    if (argc > 6)
+	    {
+	      threads = atoi(argv[6]);
+	    }
+	    convertToOPT(input, output, mem, threads);
 	  }
 	  else if (!strcmp(type, "xstream"))
 	  {
@@ -13,9 +13,18 @@
 #include <signal.h>
 #include <errno.h>
 #include <cassert>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
 #include "util.h"
 #include "networkutil.h"
 #include "mgt.h"
+#include "graphfile.h"
+#include "loadbalance.h"
+#include "placement.h"
+#include "protocol.h"
+#include "cache.h"
+#include "scheduler.h"
 
 #define MAX_PENDING 10000
 
@@ -30,6 +39,9 @@ string base_out;
 
 bool del;
 
+GraphCache* cache;
+JobScheduler* scheduler;
+
 /* used to exit cleanly */
 void catch_sigint(int sig)
 {
@@ -38,90 +50,261 @@ void catch_sigint(int sig)
 	exit(128 + sig);
 }
 
-/* Function to handle connection. Modular to think about threads in long term */
-/* port is in host architecture */
-void handle_connection(int sock, int number)
+void removeGraph(const string& graph)
 {
-	string base = base_out + "-" + to_string(number);
-	const char* base_str = base.c_str();
-	string degName = getDegName(base_str);
-	const char* degName_str = degName.c_str();
-	string adjName = getAdjName(base_str);
-	const char* adjName_str = adjName.c_str();
-	string outName = getOutName(base_str);
-	const char* outName_str = outName.c_str();
-
-	vx maxDeg = readVx(sock);
-	vx output = readVx(sock); // really a boolean
-	bool out = output != 0;
-	readFile(sock, degName_str);
-	readFile(sock, adjName_str);
-
-	vx count = readVx(sock); // how many
-	unsigned long long* los = new unsigned long long[count];
-	unsigned long long* his = new unsigned long long[count];
-	MGTAdjacencyHandler** handlers = new MGTAdjacencyHandler*[count];
-
-	vx i;
-
-	for (i = 0; i < count; ++i)
-	{
-		vx mem = readVx(sock);
-		unsigned long long avdegree;
-		los[i] = readULL(sock);
-		his[i] = readULL(sock);
-		avdegree = readULL(sock);
-		void *point = &avdegree;
-		const char* name = NULL;
-		string s;
-		if (out)
+	remove(getDegName(graph.c_str()).c_str());
+	remove(getAdjName(graph.c_str()).c_str());
+}
+
+// the chunks of a job not yet started, filled from the connection while the
+// job runs
+struct ChunkQueue {
+	mutex mtx;
+	condition_variable arrived;
+	deque<ChunkSpec> chunks;
+	unsigned held; // chunks queued, running, or asked for
+	bool ended;    // the master sends no more
+};
+
+// runs the chunks of a job on the cores the scheduler grants it, and returns
+// the result (and listing) of every chunk as soon as it finishes; a thread
+// that finishes a chunk asks the master for another one, unless there are
+// enough queued or on the way for the threads of the job. False if the
+// connection failed.
+bool runChunks(int sock, 
+               int number, 
+               ChunkQueue& queue, 
+               const string& graph, 
+               const string& outName, 
+               vx maxDeg, 
+               bool out, 
+               FileArrival* arrival)
+{
+	unsigned long long totalMem = 0;
+	unsigned count;
+	{
+		lock_guard<mutex> lock(queue.mtx);
+		count = (unsigned) queue.chunks.size();
+		for (const ChunkSpec& c : queue.chunks)
 		{
-			s = getName(outName, i);
-			name = s.c_str();
+			totalMem += c.mem;
 		}
-
-		handlers[i] = new MGTAdjacencyHandler(base, 
-		                                      maxDeg, 
-		                                      mem, 
-		                                      name,
-				                                  *((double *)point)); //FIXME
 	}
 
+	// the job runs once the machine has the cores and memory for its first
+	// chunks, on as many threads as they are, or as the job is granted cores
+	JobGrant grant = scheduler->admit(count, totalMem);
+	cout << "[Job " << number << "]: Running on " << grant.threads 
+	     << " threads with " << grant.mem << "MB" << endl;
+
+	// the threads share the memory the job was granted between them
+	MemoryGovernor governor(grant.mem, grant.threads);
+	Placement placement(grant.threads);
+	atomic<bool> lost(false);
+	mutex sending;
+	thread* threads = new thread[grant.threads];
+
+	unsigned w;
+	for (w = 0; w < grant.threads; ++w)
+	{
+		// each handler is allocated by the thread that runs it, on its node
+		threads[w] = thread([&, w]() {
+			placement.pin(w);
+			while (true)
+			{
+				ChunkSpec c;
+				{
+					unique_lock<mutex> lock(queue.mtx);
+					while (queue.chunks.empty() && !queue.ended && !lost)
+					{
+						queue.arrived.wait(lock);
+					}
+					if (queue.chunks.empty() || lost)
+					{
+						break;
+					}
+					c = queue.chunks.front();
+					queue.chunks.pop_front();
+				}
+
+				Timer t;
+				t.start();
+				string s = getName(outName, (int) c.id);
+				MGTAdjacencyHandler* handler = new MGTAdjacencyHandler(graph, 
+				                                      maxDeg, 
+				                                      placement.limitMemory(w, c.mem), 
+				                                      out ? s.c_str() : NULL,
+				                                      c.avdegree);
+				handler->setGovernor(&governor);
+				handler->setArrival(arrival);
+				handler->timedProcessAdjacency(c.low, c.high);
+
+				JobResult result;
+				result.chunk = c.id;
+				result.triangles = handler->getTriangleCount();
+				result.time = t.total();
+				delete handler;
+				{
+					lock_guard<mutex> lock(queue.mtx);
+					result.wanted = --queue.held < grant.threads ? 1 : 0;
+					queue.held += (unsigned) result.wanted;
+				}
+
+				// the count is wrong if the graph did not arrive in full
+				bool failed = arrival != NULL && !arrival->waitFor(0, MAX_EDGES);
+				if (!failed)
+				{
+					lock_guard<mutex> lock(sending);
+					failed = !lost && !sendResult(sock, result);
+					if (!failed && !lost && out)
+					{
+						failed = !writeFile(sock, s);
+					}
+				}
+				if (out && del)
+				{
+					remove(s.c_str());
+				}
+				if (failed)
+				{
+					// wakes up the receiver of the job, and the other threads
+					lock_guard<mutex> lock(queue.mtx);
+					lost = true;
+					shutdown(sock, SHUT_RDWR);
+					queue.arrived.notify_all();
+				}
+			}
+			governor.retire();
+		});
+	}
 
-	thread* threads = new thread[count];
+	for (w = 0; w < grant.threads; ++w)
+	{
+		threads[w].join();
+	}
+	delete[] threads;
+	scheduler->release(grant);
+	return !lost;
+}
 
-	if(system("sync ; sysctl vm.drop_caches=3")); // clear caches
+/* Function to handle connection, on a thread of its own */
+/* port is in host architecture */
+void handle_connection(int sock, int number)
+{
+	string base = base_out + "-" + to_string(number);
+	const char* base_str = base.c_str();
+	string outName = getOutName(base_str);
 
-	for (i = 0; i < count; ++i)
+	setNoDelay(sock);
+	JobSpec job;
+	if (!receiveJob(sock, job))
 	{
-		threads[i] = thread(&MGTAdjacencyHandler::timedProcessAdjacency, 
-		                    handlers[i], 
-		                    los[i], 
-		                    his[i]);
+		close(sock);
+		return;
+	}
+	vx maxDeg = job.maxDeg;
+	bool out = job.output;
+
+	// the graph is only sent if it is not already in the cache
+	bool caching = cache->enabled() && job.key != 0;
+	bool cached = caching && cache->lookup(job.key);
+	cout << "[Job " << number << "]: Graph " << hex << job.key << dec 
+	     << (cached ? " is" : " is not") << " cached" << endl;
+	if (!sendCached(sock, cached))
+	{
+		close(sock);
+		return;
+	}
+	string graph = base;
+	if (caching)
+	{
+		graph = cached ? cache->getBase(job.key) : cache->getPending(job.key, number);
+	}
+	// the adjacency only follows once the chunks are known
+	if (!cached && !readFile(sock, getDegName(graph.c_str())))
+	{
+		removeGraph(graph);
+		close(sock);
+		return;
 	}
 
-
-	for (i = 0; i < count; ++i)
+	// tell the master how fast this machine is, to size its chunks; until the
+	// adjacency arrives, the disk is measured on the degrees
+	string scan = cached ? getAdjFile(graph.c_str()) : getDegName(graph.c_str());
+	Throughput speed = measureThroughput(scan, min((unsigned) job.instances, scheduler->getCores()));
+	cout << "[Job " << number << "]: Intersections per second " << speed.intersections
+	     << ", scan bytes per second " << speed.scan << endl;
+	ChunkQueue queue;
+	vector<ChunkSpec> chunks;
+	vector<FileSegment> order;
+	// the master ends the job at once if other machines have done all chunks
+	if (!sendThroughput(sock, speed) || !receiveChunks(sock, chunks) ||
+	    (!cached && !chunks.empty() && !receiveOrder(sock, order)) || chunks.empty())
 	{
-		threads[i].join();
+		if (cached)
+		{
+			cache->release(job.key);
+		}
+		else
+		{
+			removeGraph(graph);
+		}
+		close(sock);
+		return;
 	}
+	queue.chunks.assign(chunks.begin(), chunks.end());
+	queue.held = (unsigned) chunks.size();
+	queue.ended = false;
 
-	unsigned long long triangleCount = 0;
-	for (i = 0; i < count; ++i)
+	// the caches of running jobs are left alone
+	if (scheduler->getRunning() == 0)
 	{
-		unsigned long long tri = handlers[i]->getTriangleCount();
-		triangleCount += tri;
-		delete handlers[i];
+		if(system("sync ; sysctl vm.drop_caches=3")); // clear caches
 	}
 
-	cout << "Total count: " << triangleCount << endl;
+	// the adjacency arrives while the job waits for its turn and runs, the
+	// edges of this machine first, and reads of the parts not yet there wait
+	// for them; then further chunks arrive as the threads ask for them, until
+	// the master sends an empty batch
+	FileArrival arrival(order);
+	thread receiver([&]() {
+		bool connected = cached || readFileSegments(sock, getAdjName(graph.c_str()), order, &arrival);
+		vector<ChunkSpec> more;
+		while (connected && receiveChunks(sock, more) && !more.empty())
+		{
+			lock_guard<mutex> lock(queue.mtx);
+			queue.chunks.insert(queue.chunks.end(), more.begin(), more.end());
+			queue.arrived.notify_all();
+		}
+		lock_guard<mutex> lock(queue.mtx);
+		queue.ended = true;
+		queue.arrived.notify_all();
+	});
+	if (!cached)
+	{
+		arrival.waitForStart();
+	}
 
-	writeULL(sock, triangleCount);	
+	runChunks(sock, number, queue, graph, outName, maxDeg, out, 
+	          cached ? NULL : &arrival);
+	receiver.join();
 
-	if (out)
+	bool complete = cached || arrival.isComplete();
+	if (!complete)
 	{
-		concatenate(base, count);
-		writeFile(sock, outName_str);
+		cerr << "[Job " << number << "]: The graph did not arrive in full, dropping the job" << endl;
+	}
+	else if (caching && !cached)
+	{
+		if (cache->insert(job.key, graph))
+		{
+			graph = cache->getBase(job.key);
+			cached = true;
+		}
+		else
+		{
+			caching = false;
+		}
 	}
 
 	shutdown(sock, SHUT_WR);
@@ -129,27 +312,17 @@ void handle_connection(int sock, int number)
 
 	close(sock);
 
-	delete[] los;
-	delete[] his;
-	delete[] handlers;
-	delete[] threads;
-
-	if (del)
+	// cached graphs stay until evicted
+	if (!complete || (del && !caching))
 	{
-		remove(degName_str);
-		remove(adjName_str);
-		if (out)
-		{
-			remove(outName_str);
-			for (i = 0; i < count; ++i)
-			{
-				string name = getName(outName, i);
-				remove(name.c_str());
-			}
-		}
+		removeGraph(graph);
+	}
+	if (cached)
+	{
+		cache->release(job.key);
 	}
 
-	cout << "Finished" << endl;
+	cout << "[Job " << number << "]: Finished" << endl;
 }
 
 int main(int argc, char** argv)
@@ -177,6 +350,8 @@ int main(int argc, char** argv)
 
 	del = atoi(argv[2]) != 0;
 	cout << "Will" << (del ? " " : " not ") << "delete files" << endl;
+	cache = new GraphCache();
+	scheduler = new JobScheduler();
 
 	memset((char*) &sin, 0, sizeof(sin));
 	sin.sin_family = AF_INET;
@@ -198,8 +373,10 @@ int main(int argc, char** argv)
 		exit(1);
 	}
 
+	setBufferSizes(socket_number); // inherited by accepted connections
 	listen(socket_number, MAX_PENDING);
 	signal(SIGINT, catch_sigint); /* Register to exit cleanly */
+	signal(SIGPIPE, SIG_IGN); /* a master going away only fails its job */
 
 	cerr << "Listening for up to " << MAX_PENDING << " connections on " << port << endl;
 
@@ -217,7 +394,8 @@ int main(int argc, char** argv)
 
 		++connections;
 
-		handle_connection(new_socket, connections);
+		// jobs run side by side, queued by the scheduler for cores and memory
+		thread(handle_connection, new_socket, connections).detach();
 	}
 
 	exit(0);
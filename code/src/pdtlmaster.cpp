@@ -16,7 +16,13 @@
 #include "util.h"
 #include "networkutil.h"
 #include "fileparser.h"
+#include "graphfile.h"
 #include "loadbalance.h"
+#include "placement.h"
+#include "protocol.h"
+#include "cache.h"
+#include "tracker.h"
+#include "inputstream.h"
 
 // Master connects to the various clients and delegates responsibility for
 // different sections of the graph
@@ -26,24 +32,30 @@ using namespace std;
 string adjName;
 string degName;
 string outName;
+unsigned long long graphkey;
+unsigned long long adjStart; // byte offset of the edges in the adjacency file
+bool compressedAdj;
+unsigned long long degBytes; // of the degree file sent to clients
 vx maxDeg;
 vx output;
 
 vx* mems;
 vx* instances;
+bool* cachedGraph; // per client
 
-atomic<unsigned long long> triangleCount;
+atomic<bool> finished; // all chunks are done
 
 inline int getIndex(int i)
 {
 	return 6 + 4*i;
 }
 
-void makeConnection(const char* ip, 
-                    int port, 
-                    int serv, 
-                    ThreadInfo *info,
-		                unsigned start)
+// sends the degrees to a client, unless it has the graph cached, and reads
+// back how fast it is
+int makeConnection(const char* ip, 
+                   int port, 
+                   int serv, 
+                   Throughput* speed)
 {
 	struct sockaddr_in sin;
 	memset((char*) &sin, 0, sizeof(sin));
@@ -52,76 +64,229 @@ void makeConnection(const char* ip,
 	if (!inet_pton(AF_INET, ip, &sin.sin_addr))
 	{
 		cerr << ip << " is not a valid IP address" << endl;
-		return;
+		return -1;
 	}
 
 	int soc = socket(PF_INET, SOCK_STREAM, 0);
 	if (soc < 0)
 	{
 		cerr << strerror(errno) << ": Error with setting up socket" << endl;
-		return;
+		return -1;
 	}
+	// before connecting, so that the window scale covers the buffers
+	setBufferSizes(soc);
 
 	if (connect(soc, (struct sockaddr*) &sin, sizeof(sin)) < 0)
 	{
 		cerr << strerror(errno) << ": Error with connecting" << endl;
 		close(soc);
-		return;
+		return -1;
 	}
+	setNoDelay(soc);
 
-	writeVx(soc, maxDeg);
-	writeVx(soc, output);
+	JobSpec job;
+	job.maxDeg = maxDeg;
+	job.output = output != 0;
+	job.instances = instances[serv];
+	job.key = graphkey;
 	Timer t;
 	t.start();
-	writeFile(soc, degName);
-	writeFile(soc, adjName);
-	cout << "[Server " << serv << "]: Copying files took " << t.lap() << endl;
+	bool cached;
+	if (!sendJob(soc, job) || !receiveCached(soc, cached))
+	{
+		close(soc);
+		return -1;
+	}
+	cachedGraph[serv] = cached;
+	if (cached)
+	{
+		cout << "[Server " << serv << "]: Graph was cached" << endl;
+	}
+	else
+	{
+		if (!writeFile(soc, degName, degBytes))
+		{
+			close(soc);
+			return -1;
+		}
+		cout << "[Server " << serv << "]: Copying degrees took " << t.lap() << endl;
+	}
 
-	vx count = instances[serv];
-	writeVx(soc, count);
+	if (!receiveThroughput(soc, *speed))
+	{
+		close(soc);
+		return -1;
+	}
+	cout << "[Server " << serv << "]: Intersections per second " << speed->intersections
+	     << ", scan bytes per second " << speed->scan << endl;
+	return soc;
+}
 
-	vx i;
-	unsigned long long total = info->getchunks()[start+count] - info->getchunks()[start];
-	for (i = 0;  i < count; ++i)
+// the listing of a chunk is kept if its result was the first to arrive
+void keepListing(const string& name, unsigned chunk, bool counted)
+{
+	if (counted)
+	{
+		rename(name.c_str(), getName(outName, chunk).c_str());
+	}
+	else
 	{
-		unsigned long long begin = info->getchunks()[start+i],
-			      end = info->getchunks()[start+i+1];
-		writeVx(soc, (vx)((unsigned long long)mems[serv]*count*(end-begin)
-					/total));
-		writeULL(soc, begin);
-		writeULL(soc, end);
-		writeULL(soc, *((unsigned long long *)&(info->getavdegree()[start+i])));//FIXME
+		remove(name.c_str());
 	}
+}
 
+// the order the adjacency is sent in to a client that runs edges [low, high).
+// The first page of the file comes first, as readers look at it to know how
+// to read the file: it holds the header of a container, and shows whether the
+// file is compressed. Then come the edges of the client, and then the rest.
+// The offsets of a container are not sent again, as they came with the
+// degrees. A compressed file is sent in order, as the edges of a client
+// cannot be found in it.
+vector<FileSegment> adjacencyOrder(unsigned long long low, unsigned long long high)
+{
+	unsigned long long size = getFileSize(adjName.c_str()),
+	                   head = min(size, (unsigned long long) GRAPH_PAGE),
+	                   edges = max(adjStart, head);
+	vector<FileSegment> order;
+	FileSegment top = {0, head};
+	order.push_back(top);
+	if (compressedAdj)
+	{
+		FileSegment rest = {head, size - head};
+		order.push_back(rest);
+		return order;
+	}
 
-	unsigned long long tri = readULL(soc);
-	cout << "[Server " << serv << "]: Calculating took " << t.lap() << endl;
+	unsigned long long first = max(adjStart + low*sizeof(vx), edges),
+	                   last = max(adjStart + high*sizeof(vx), first);
+	FileSegment mine = {first, last - first}, before = {edges, first - edges}, after = {last, size - last};
+	order.push_back(mine);
+	order.push_back(before);
+	order.push_back(after);
+	return order;
+}
 
+// hands a client chunks as its threads ask for them, and collects their
+// results. The client first gets a chunk for each of its threads, and the
+// adjacency follows them, unless the client has the graph cached, starting
+// with the edges of the chunks queued for the client, so that it can start on
+// them while the rest arrives. Each result asks for the chunks the client
+// has threads running out of, and while it asks, the tracker is looked at
+// again every so often for chunks to hand out.
+// If the connection fails, the chunks of the client go to other machines.
+void runConnection(int soc, 
+                   int serv, 
+                   ThreadInfo *info,
+                   unsigned start,
+                   unsigned own,
+                   ChunkTracker* tracker)
+{
+	Timer t;
+	t.start();
+	bool sent = cachedGraph[serv];
+	bool lost = false;
+	bool more = true; // the tracker has chunks left
+	unsigned wanted = instances[serv];
+	vector<unsigned> given; // without a result yet
+	vector<unsigned> batch;
+
+	while (!lost && (more || !given.empty()))
+	{
+		// only waits for chunks while the client has none to run
+		if (more && wanted > 0)
+		{
+			more = tracker->next(serv, wanted, batch, given.empty());
+		}
+		if (!batch.empty())
+		{
+			vector<ChunkSpec> chunks(batch.size());
+			size_t i;
+			for (i = 0; i < batch.size(); ++i)
+			{
+				chunks[i].id = batch[i];
+				chunks[i].mem = mems[serv];
+				chunks[i].low = info->getchunks()[batch[i]];
+				chunks[i].high = info->getchunks()[batch[i]+1];
+				chunks[i].avdegree = info->getavdegree()[batch[i]];
+			}
+			lost = !sendChunks(soc, chunks);
+			wanted -= (unsigned) batch.size();
+			given.insert(given.end(), batch.begin(), batch.end());
+			batch.clear();
+		}
+		if (!lost && !sent && !given.empty())
+		{
+			vector<FileSegment> order = adjacencyOrder(info->getchunks()[start], 
+			                                           info->getchunks()[start+own]);
+			lost = !sendOrder(soc, order);
+			if (!lost)
+			{
+				lost = !writeFileSegments(soc, adjName, order);
+			}
+			if (!lost)
+			{
+				cout << "[Server " << serv << "]: Copying the adjacency took " << t.lap() << endl;
+			}
+			sent = true;
+		}
+		if (lost || given.empty() || 
+		    (more && wanted > 0 && !waitReadable(soc, STRAGGLER_POLL)))
+		{
+			continue;
+		}
 
-	if (output)
+		JobResult result;
+		vector<unsigned>::iterator it;
+		lost = !receiveResult(soc, result) || 
+		       (it = find(given.begin(), given.end(), result.chunk)) == given.end();
+		string name = getName(getName(outName, (unsigned) result.chunk), serv);
+		if (!lost && output)
+		{
+			lost = !readFile(soc, name);
+		}
+		if (!lost)
+		{
+			given.erase(it);
+			wanted += (unsigned) result.wanted;
+			bool counted = tracker->complete(serv, (unsigned) result.chunk, result.triangles);
+			cout << "[Server " << serv << "]: Chunk " << result.chunk << " took " 
+			     << result.time << " on the server" << (counted ? "" : ", a second copy") << endl;
+			if (output)
+			{
+				keepListing(name, (unsigned) result.chunk, counted);
+			}
+		}
+	}
+
+	if (lost && !finished)
 	{
-		string name = getName(outName, serv);
-		readFile(soc, name);
+		cerr << "[Server " << serv << "]: Lost the connection, its chunks go to other machines" << endl;
+		tracker->fail(serv);
+	}
+	else if (!lost)
+	{
+		sendChunks(soc, vector<ChunkSpec>());
+		cout << "[Server " << serv << "]: Calculating took " << t.lap() << endl;
 	}
 
 	shutdown(soc, SHUT_WR);
 	shutdown(soc, SHUT_RD);
-
-	close(soc);
-	triangleCount += tri;
 }
 
 int main(int argc, char** argv)
 {
-	if (argc < 10 || argc % 4 != 2)
+	if (argc < 10 || (argc % 4 != 2 && argc % 4 != 3))
 	{
-		cerr << "usage: " << argv[0] << " filename maxdeg memsize instances output ip port mem instances ...." << endl;
+		cerr << "usage: " << argv[0] << " filename maxdeg memsize instances output ip port mem instances .... [relabeled]" << endl;
 		return 1;
 	}
 
 	Timer t;
 	t.start();
 
+	// a client going away shows as a failed send, and its chunks go elsewhere
+	signal(SIGPIPE, SIG_IGN);
+
 	const char* orig = argv[1];
 
 	string out(orig);
@@ -131,16 +296,33 @@ int main(int argc, char** argv)
 	size_t mymem = atol(argv[3]);
 	unsigned mycount = atol(argv[4]);
 
+	// optional trailing argument for graphs produced by parser.bin relabel
+	// or reorder
+	bool relabeled = argc % 4 == 3 && atoi(argv[argc - 1]) != 0;
+
 	maxDeg = (vx) atoi(argv[2]);
-	if (maxDeg == 0)
+	GraphHeader header;
+	if (maxDeg == 0 && readGraphHeader(orig, header) && (header.flags & GRAPH_ORIENTED))
+	{
+		// clients receive the container as both of their graph files
+		maxDeg = (vx) header.maxDeg;
+		base = orig;
+	}
+	else if (maxDeg == 0)
 	{
 		maxDeg = orient(orig, base, mymem,
 				mycount);
 		cout << "Orientation took " << t.lap()<< endl;
 	}
-	adjName = getAdjName(base);
-	degName = getDegName(base);
+	adjName = getAdjFile(base);
+	degName = getDegFile(base);
 	outName = getOutName(base);
+	graphkey = graphKey(base, degName, adjName);
+	adjStart = getAdjStart(base);
+	compressedAdj = InputStream::isCompressed(adjName);
+	// a container is sent to clients as both of their graph files, but only
+	// the header and offsets as the degrees
+	degBytes = degName == adjName ? adjStart : getFileSize(degName.c_str());
 
 	output = (vx) atoi(argv[5]);
 
@@ -148,6 +330,7 @@ int main(int argc, char** argv)
 
 	mems = new vx[servers];
 	instances = new vx[servers];
+	cachedGraph = new bool[servers];
 	unsigned i;
 
 	unsigned totalInstances = 0;
@@ -162,13 +345,11 @@ int main(int argc, char** argv)
 	totalInstances += mycount;
 	thread* threads = new thread[servers];
 
-	triangleCount = 0;
+	finished = false;
 
-	Volume info(base, mymem, maxDeg, mycount, totalInstances,
-			orig);
-	info.loadbalance();
-	cout << "Load balancing took: " << t.lap() << endl;
-	totalInstances = 0;
+	// copy the graph to the clients, and have every machine measure itself
+	int* sockets = new int[servers];
+	Throughput* speeds = new Throughput[servers];
 	for (i = 0; i < servers; ++i)
 	{
 		int index = getIndex(i);
@@ -180,68 +361,169 @@ int main(int argc, char** argv)
 			return 1;
 		}
 
-		threads[i] = thread(makeConnection, ip, port, i, &info, totalInstances);
+		threads[i] = thread([=]() {
+			sockets[i] = makeConnection(ip, port, i, &speeds[i]);
+		});
+	}
+	Throughput myspeed = measureThroughput(adjName, mycount);
+	cout << "[Master]: Intersections per second " << myspeed.intersections
+	     << ", scan bytes per second " << myspeed.scan << endl;
+	for (i = 0; i < servers; ++i)
+	{
+		threads[i].join();
+	}
+
+	// the edges are cut into a few chunks per thread, each queued for a
+	// machine and sized in proportion to its speed, so that idle machines
+	// take chunks queued for the others; clients that could not be reached
+	// get none
+	unsigned grain = chunkGrain();
+	vector<double> weights;
+	totalInstances = 0;
+	for (i = 0; i < servers; ++i)
+	{
+		if (sockets[i] < 0)
+		{
+			cerr << "Could not reach server " << i << ", going on without it" << endl;
+			instances[i] = 0;
+			continue;
+		}
+		weights.insert(weights.end(), instances[i]*grain, 1/edgeTime(speeds[i])/instances[i]);
 		totalInstances += instances[i];
 	}
-	MGTAdjacencyHandler** handlers = new MGTAdjacencyHandler*[mycount];
+	weights.insert(weights.end(), mycount*grain, 1/edgeTime(myspeed)/mycount);
+	totalInstances += mycount;
+	if (totalInstances == 0)
+	{
+		cerr << "No machine to run on" << endl;
+		return 1;
+	}
+
+	Volume info(base, mymem, maxDeg, mycount, totalInstances*grain,
+			orig);
+	info.setWeights(weights);
+	info.loadbalance();
+	cout << "Load balancing took: " << t.lap() << endl;
+
+	// the master is the last machine
+	unsigned chunkCount = totalInstances*grain;
+	ChunkTracker tracker(chunkCount, servers + 1);
+	unsigned first = 0;
+	for (i = 0; i < servers; ++i)
+	{
+		if (sockets[i] < 0)
+		{
+			tracker.fail(i);
+			continue;
+		}
+		tracker.assign(i, first, instances[i]*grain);
+		threads[i] = thread(runConnection, sockets[i], i, &info, first, instances[i]*grain, &tracker);
+		first += instances[i]*grain;
+	}
+	tracker.assign(servers, first, mycount*grain);
+	if (mycount == 0)
+	{
+		tracker.fail(servers);
+	}
 
-	unsigned long long total = info.getchunks()[totalInstances+mycount]
-		- info.getchunks()[totalInstances];
 	thread* mythreads = new thread[mycount];
-	unsigned long mytriangles = 0;
+	Placement placement(mycount);
+	MemoryGovernor governor((unsigned long long) mymem*mycount, mycount);
 	Timer mytimer;
 	mytimer.start();
 	for (i = 0;  i < mycount; ++i)
 	{
-		unsigned long long begin = info.getchunks()[totalInstances+i],
-			      end = info.getchunks()[totalInstances+i+1];
-		const char *name = NULL;
-		string s;
-		if(output)
-		{
-			s = getName(getOutName(base), servers);
-			name = s.c_str();
-		}
-		handlers[i] = new MGTAdjacencyHandler(base, 
-		                                      maxDeg, 
-				                                  mymem*mycount*(end-begin)/total,
-				                                  name,
-				                                  info.getavdegree()[totalInstances+i]);
-		mythreads[i] = thread(&MGTAdjacencyHandler::timedProcessAdjacency, 
-		                      handlers[i], 
-		                      begin, 
-		                      end);
+		// each handler is allocated by the thread that runs it, on its node;
+		// the thread takes chunks one at a time, from the same queues as the
+		// clients
+		mythreads[i] = thread([&, i]() {
+			placement.pin(i);
+			vector<unsigned> batch;
+			while (tracker.next(servers, 1, batch))
+			{
+				unsigned c = batch[0];
+				string s = getName(getName(outName, c), servers);
+				MGTAdjacencyHandler* handler = new MGTAdjacencyHandler(base, 
+				                                                       maxDeg, 
+				                                                       placement.limitMemory(i, mymem),
+				                                                       output ? s.c_str() : NULL,
+				                                                       info.getavdegree()[c]);
+				handler->setGovernor(&governor);
+				handler->timedProcessAdjacency(info.getchunks()[c], info.getchunks()[c+1]);
+				unsigned long long tri = handler->getTriangleCount();
+				delete handler;
+				bool counted = tracker.complete(servers, c, tri);
+				if (output)
+				{
+					keepListing(s, c, counted);
+				}
+			}
+			governor.retire();
+		});
 	}
 
 	for(i = 0; i < mycount; i++) {
 		mythreads[i].join();
-		mytriangles += handlers[i]->getTriangleCount();
-		delete handlers[i];
 	}
-	delete[] handlers;
 	delete[] mythreads;
 	cout << "[Master]: Calculating took " << mytimer.lap() << endl;
 
+	// clients still running second copies are not waited for; the read side
+	// is shut, so that connections done with their chunks still end the job
+	// of their client
+	bool complete = tracker.waitAll();
+	finished = true;
 	for (i = 0; i < servers; ++i)
 	{
-		threads[i].join();
+		if (sockets[i] >= 0)
+		{
+			shutdown(sockets[i], SHUT_RD);
+		}
+	}
+	for (i = 0; i < servers; ++i)
+	{
+		if (threads[i].joinable())
+		{
+			threads[i].join();
+		}
+		if (sockets[i] >= 0)
+		{
+			close(sockets[i]);
+		}
 	}
 
 	delete[] threads;
+	delete[] sockets;
+	delete[] speeds;
 	delete[] mems;
 	delete[] instances;
+	delete[] cachedGraph;
 
+	if (!complete)
+	{
+		cerr << "Some chunks could not be run on any machine" << endl;
+		return 1;
+	}
 
 	cout << "Calculating took " << t.lap() << endl;
+	cout << "Second copies of chunks run: " << tracker.getSecondCopies() << endl;
 
 	if (output)
 	{
-		concatenate(outName, servers);
+		concatenate(outName, chunkCount);
+		for (unsigned i = 0; i < chunkCount; ++i)
+		{
+			string name = getName(outName, i);
+			remove(name.c_str());
+		}
+		if (relabeled)
+		{
+			mapTriangles(outName, getMapName(orig));
+		}
 	}
 
 	cout << "Concatenation took " << t.lap() << endl;
-	triangleCount += mytriangles;
-	cout << "Triangle num: " << triangleCount << endl;
+	cout << "Triangle num: " << tracker.getTriangles() << endl;
 	cout << "Total time " << t.total() << endl;
 	return 0;
 }
@@ -0,0 +1,124 @@
+/*
+ * PDTL: Parallel and Distributed Triangle Listing for Massive Graphs
+ * Ilias Giechaskiel, George Panagopoulos, Eiko Yoneki
+ * 44th International Conference on Parallel Processing (ICPP), Beijing 2015
+ * 
+ * DOI: 10.1109/ICPP.2015.46
+ * 
+ * https://github.com/giech/pdtl
+ */
+
+#include "placement.h"
+
+#include <fstream>
+#include <sstream>
+#include <sched.h>
+#include <pthread.h>
+
+using namespace std;
+
+#define NODE_DIR "/sys/devices/system/node/node"
+
+// parses a list of CPUs such as 0-3,8,10-11
+static vector<unsigned> parseCpuList(const string& list)
+{
+	vector<unsigned> result;
+	istringstream ranges(list);
+	string range;
+	while (getline(ranges, range, ','))
+	{
+		unsigned first, last;
+		char dash;
+		istringstream r(range);
+		if (!(r >> first))
+			continue;
+		last = first;
+		if (r >> dash >> last && dash != '-')
+			last = first;
+		for (unsigned c = first; c <= last; ++c)
+			result.push_back(c);
+	}
+	return result;
+}
+
+Placement::Placement(unsigned thr)
+: threads(thr)
+{
+	const char* pin = getenv("PDTL_PIN");
+	pinning = pin != NULL && atoi(pin) != 0;
+
+	unsigned node;
+	for (node = 0; ; ++node)
+	{
+		string dir = NODE_DIR + to_string(node);
+		ifstream list(dir + "/cpulist");
+		if (!list)
+			break;
+		string text;
+		getline(list, text);
+		vector<unsigned> nodeCpus = parseCpuList(text);
+		if (nodeCpus.empty())
+			continue; // memory only
+
+		size_t free = 0;
+		ifstream meminfo(dir + "/meminfo");
+		string line;
+		while (getline(meminfo, line))
+		{
+			size_t at = line.find("MemFree:");
+			if (at != string::npos)
+			{
+				istringstream kb(line.substr(at + 8));
+				kb >> free;
+				free /= 1024;
+			}
+		}
+		cpus.push_back(nodeCpus);
+		freeMem.push_back(free);
+	}
+
+	if (pinning && cpus.empty())
+	{
+		cerr << "No NUMA nodes found, not pinning threads" << endl;
+		pinning = false;
+	}
+	if (pinning)
+	{
+		cout << "Pinning " << threads << " threads to " << cpus.size() << " nodes" << endl;
+	}
+}
+
+unsigned Placement::getNode(unsigned thread) const
+{
+	if (cpus.empty() || threads == 0)
+		return 0;
+	return (unsigned) ((unsigned long long) (thread % threads)*cpus.size()/threads);
+}
+
+void Placement::pin(unsigned thread) const
+{
+	if (!pinning)
+		return;
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	for (unsigned c : cpus[getNode(thread)])
+		CPU_SET(c, &set);
+	if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0)
+	{
+		cerr << "Could not pin thread " << thread << endl;
+	}
+}
+
+size_t Placement::limitMemory(unsigned thread, size_t mem) const
+{
+	if (!pinning)
+		return mem;
+	unsigned node = getNode(thread), t, sharing = 0;
+	for (t = 0; t < threads; ++t)
+	{
+		if (getNode(t) == node)
+			++sharing;
+	}
+	size_t share = freeMem[node]/max(sharing, 1U);
+	return share > 0 ? min(mem, share) : mem;
+}
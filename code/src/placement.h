@@ -0,0 +1,39 @@
+/*
+ * PDTL: Parallel and Distributed Triangle Listing for Massive Graphs
+ * Ilias Giechaskiel, George Panagopoulos, Eiko Yoneki
+ * 44th International Conference on Parallel Processing (ICPP), Beijing 2015
+ * 
+ * DOI: 10.1109/ICPP.2015.46
+ * 
+ * https://github.com/giech/pdtl
+ */
+
+#pragma once
+
+#include "util.h"
+
+#include <vector>
+
+// Places worker threads on the NUMA nodes of the machine, as listed in sysfs.
+// With PDTL_PIN set, thread i is pinned to the CPUs of one node, threads being
+// spread over the nodes in contiguous blocks, so that the memory of its
+// handler is first touched, and so allocated, on that node. The threads of a
+// node then share the memory free on it.
+
+class Placement {
+	public:
+		Placement(unsigned threads);
+		inline bool enabled() const { return pinning; }
+		inline unsigned getNodes() const { return (unsigned) cpus.size(); }
+		unsigned getNode(unsigned thread) const;
+		// pins the calling thread to the CPUs of the node of the given thread
+		void pin(unsigned thread) const;
+		// memory (in MB) the thread may use out of what it asks for
+		size_t limitMemory(unsigned thread, size_t mem) const;
+
+	private:
+		unsigned threads;
+		bool pinning;
+		std::vector<std::vector<unsigned> > cpus; // per node
+		std::vector<size_t> freeMem; // in MB, per node
+};
@@ -0,0 +1,266 @@
+/*
+ * PDTL: Parallel and Distributed Triangle Listing for Massive Graphs
+ * Ilias Giechaskiel, George Panagopoulos, Eiko Yoneki
+ * 44th International Conference on Parallel Processing (ICPP), Beijing 2015
+ * 
+ * DOI: 10.1109/ICPP.2015.46
+ * 
+ * https://github.com/giech/pdtl
+ */
+
+#include "protocol.h"
+
+#include <errno.h>
+
+using namespace std;
+
+#define HEADER_WORDS 4
+
+Message::Message(MessageType t)
+: type(t), pos(0), valid(true)
+{}
+
+void Message::putULL(unsigned long long v)
+{
+	unsigned long long net = toNetworkULL(v);
+	const char* bytes = (const char*) &net;
+	data.insert(data.end(), bytes, bytes + sizeof(net));
+}
+
+void Message::putDouble(double d)
+{
+	unsigned long long bits;
+	memcpy(&bits, &d, sizeof(d));
+	putULL(bits);
+}
+
+unsigned long long Message::getULL()
+{
+	unsigned long long net;
+	if (pos + sizeof(net) > data.size())
+	{
+		valid = false;
+		return 0;
+	}
+	memcpy(&net, &data[pos], sizeof(net));
+	pos += sizeof(net);
+	return fromNetworkULL(net);
+}
+
+double Message::getDouble()
+{
+	unsigned long long bits = getULL();
+	double d;
+	memcpy(&d, &bits, sizeof(d));
+	return d;
+}
+
+bool Message::send(int sock) const
+{
+	uint32_t header[HEADER_WORDS] = {
+		htonl(PROTOCOL_MAGIC),
+		htonl(PROTOCOL_VERSION),
+		htonl((uint32_t) type),
+		htonl((uint32_t) data.size())
+	};
+	vector<char> frame((const char*) header, (const char*) header + sizeof(header));
+	frame.insert(frame.end(), data.begin(), data.end());
+
+	size_t sent = 0;
+	while (sent < frame.size())
+	{
+		ssize_t n = ::send(sock, &frame[sent], frame.size() - sent, 0);
+		if (n <= 0)
+		{
+			cerr << strerror(errno) << ": Error sending message " << type << endl;
+			return false;
+		}
+		sent += n;
+	}
+	return true;
+}
+
+bool Message::receive(int sock)
+{
+	uint32_t header[HEADER_WORDS];
+	if (recv(sock, (char*) header, sizeof(header), MSG_WAITALL) != sizeof(header))
+	{
+		cerr << "Connection closed while waiting for message " << type << endl;
+		return false;
+	}
+	uint32_t magic = ntohl(header[0]);
+	uint32_t version = ntohl(header[1]);
+	uint32_t got = ntohl(header[2]);
+	uint32_t length = ntohl(header[3]);
+	if (magic != PROTOCOL_MAGIC)
+	{
+		cerr << "Not a PDTL message" << endl;
+		return false;
+	}
+	if (version != PROTOCOL_VERSION)
+	{
+		cerr << "Protocol version " << version << ", expected " << PROTOCOL_VERSION << endl;
+		return false;
+	}
+	if (got != (uint32_t) type || length > MAX_MESSAGE)
+	{
+		cerr << "Unexpected message " << got << " of " << length 
+		     << " bytes, expected " << type << endl;
+		return false;
+	}
+
+	data.resize(length);
+	pos = 0;
+	if (length > 0 && recv(sock, &data[0], length, MSG_WAITALL) != (ssize_t) length)
+	{
+		cerr << "Connection closed in message " << type << endl;
+		return false;
+	}
+	valid = true;
+	return true;
+}
+
+bool sendJob(int sock, const JobSpec& job)
+{
+	Message m(MSG_JOB);
+	m.putULL(job.maxDeg);
+	m.putULL(job.output ? 1 : 0);
+	m.putULL(job.instances);
+	m.putULL(job.key);
+	return m.send(sock);
+}
+
+bool receiveJob(int sock, JobSpec& job)
+{
+	Message m(MSG_JOB);
+	if (!m.receive(sock))
+		return false;
+	job.maxDeg = (vx) m.getULL();
+	job.output = m.getULL() != 0;
+	job.instances = (vx) m.getULL();
+	job.key = m.getULL();
+	return m.ok();
+}
+
+bool sendCached(int sock, bool cached)
+{
+	Message m(MSG_CACHED);
+	m.putULL(cached ? 1 : 0);
+	return m.send(sock);
+}
+
+bool receiveCached(int sock, bool& cached)
+{
+	Message m(MSG_CACHED);
+	if (!m.receive(sock))
+		return false;
+	cached = m.getULL() != 0;
+	return m.ok();
+}
+
+bool sendOrder(int sock, const vector<FileSegment>& order)
+{
+	Message m(MSG_ORDER);
+	m.putULL(order.size());
+	size_t i;
+	for (i = 0; i < order.size(); ++i)
+	{
+		m.putULL(order[i].offset);
+		m.putULL(order[i].length);
+	}
+	return m.send(sock);
+}
+
+bool receiveOrder(int sock, vector<FileSegment>& order)
+{
+	Message m(MSG_ORDER);
+	if (!m.receive(sock))
+		return false;
+	unsigned long long count = m.getULL();
+	order.clear();
+	unsigned long long i;
+	for (i = 0; i < count && m.ok(); ++i)
+	{
+		FileSegment segment;
+		segment.offset = m.getULL();
+		segment.length = m.getULL();
+		order.push_back(segment);
+	}
+	return m.ok();
+}
+
+bool sendThroughput(int sock, const Throughput& speed)
+{
+	Message m(MSG_THROUGHPUT);
+	m.putDouble(speed.intersections);
+	m.putDouble(speed.scan);
+	return m.send(sock);
+}
+
+bool receiveThroughput(int sock, Throughput& speed)
+{
+	Message m(MSG_THROUGHPUT);
+	if (!m.receive(sock))
+		return false;
+	speed.intersections = m.getDouble();
+	speed.scan = m.getDouble();
+	return m.ok();
+}
+
+bool sendChunks(int sock, const vector<ChunkSpec>& chunks)
+{
+	Message m(MSG_CHUNKS);
+	m.putULL(chunks.size());
+	for (const ChunkSpec& c : chunks)
+	{
+		m.putULL(c.id);
+		m.putULL(c.mem);
+		m.putULL(c.low);
+		m.putULL(c.high);
+		m.putDouble(c.avdegree);
+	}
+	return m.send(sock);
+}
+
+bool receiveChunks(int sock, vector<ChunkSpec>& chunks)
+{
+	Message m(MSG_CHUNKS);
+	if (!m.receive(sock))
+		return false;
+	unsigned long long count = m.getULL();
+	chunks.clear();
+	unsigned long long i;
+	for (i = 0; i < count && m.ok(); ++i)
+	{
+		ChunkSpec c;
+		c.id = m.getULL();
+		c.mem = m.getULL();
+		c.low = m.getULL();
+		c.high = m.getULL();
+		c.avdegree = m.getDouble();
+		chunks.push_back(c);
+	}
+	return m.ok();
+}
+
+bool sendResult(int sock, const JobResult& result)
+{
+	Message m(MSG_RESULT);
+	m.putULL(result.chunk);
+	m.putULL(result.triangles);
+	m.putDouble(result.time);
+	m.putULL(result.wanted);
+	return m.send(sock);
+}
+
+bool receiveResult(int sock, JobResult& result)
+{
+	Message m(MSG_RESULT);
+	if (!m.receive(sock))
+		return false;
+	result.chunk = m.getULL();
+	result.triangles = m.getULL();
+	result.time = m.getDouble();
+	result.wanted = m.getULL();
+	return m.ok();
+}
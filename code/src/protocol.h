@@ -0,0 +1,94 @@
+/*
+ * PDTL: Parallel and Distributed Triangle Listing for Massive Graphs
+ * Ilias Giechaskiel, George Panagopoulos, Eiko Yoneki
+ * 44th International Conference on Parallel Processing (ICPP), Beijing 2015
+ * 
+ * DOI: 10.1109/ICPP.2015.46
+ * 
+ * https://github.com/giech/pdtl
+ */
+
+#pragma once
+
+#include "util.h"
+#include "networkutil.h"
+#include "loadbalance.h"
+
+#include <vector>
+
+#define PROTOCOL_MAGIC 0x5044544C // PDTL
+#define PROTOCOL_VERSION 5
+#define MAX_MESSAGE (64 << 20)
+
+// Control messages between the master and its clients. Each message is one
+// frame, sent with a single send: a header of magic, version, type and
+// payload length, followed by the payload, all in network byte order.
+
+enum MessageType {
+	MSG_JOB = 1,
+	MSG_THROUGHPUT = 2,
+	MSG_CHUNKS = 3,
+	MSG_RESULT = 4,
+	MSG_CACHED = 5,
+	MSG_ORDER = 6
+};
+
+struct JobSpec {
+	vx maxDeg;
+	bool output;
+	vx instances;
+	unsigned long long key; // content key of the graph, or 0
+};
+
+struct ChunkSpec {
+	unsigned long long id; // of the chunk in the whole run
+	unsigned long long mem; // in MB
+	unsigned long long low;
+	unsigned long long high;
+	double avdegree;
+};
+
+struct JobResult {
+	unsigned long long chunk;
+	unsigned long long triangles;
+	double time;
+	unsigned long long wanted; // further chunks the client asks for
+};
+
+class Message {
+	public:
+		Message(MessageType type);
+		void putULL(unsigned long long v);
+		void putDouble(double d);
+		// reading past the end of the payload marks the message invalid
+		unsigned long long getULL();
+		double getDouble();
+		inline bool ok() const { return valid; }
+		bool send(int sock) const;
+		// fails unless a well-formed frame of the expected type arrives
+		bool receive(int sock);
+
+	private:
+		MessageType type;
+		std::vector<char> data;
+		size_t pos;
+		bool valid;
+};
+
+bool sendJob(int sock, const JobSpec& job);
+bool receiveJob(int sock, JobSpec& job);
+// whether the client already has the graph, so that the files are not sent
+bool sendCached(int sock, bool cached);
+bool receiveCached(int sock, bool& cached);
+// the order in which the segments of the adjacency file follow
+bool sendOrder(int sock, const std::vector<FileSegment>& order);
+bool receiveOrder(int sock, std::vector<FileSegment>& order);
+bool sendThroughput(int sock, const Throughput& speed);
+bool receiveThroughput(int sock, Throughput& speed);
+// chunks are sent in batches, and the client returns the result (and the
+// listing) of every chunk as it finishes, asking for more as its threads run
+// out; an empty batch ends the job
+bool sendChunks(int sock, const std::vector<ChunkSpec>& chunks);
+bool receiveChunks(int sock, std::vector<ChunkSpec>& chunks);
+bool sendResult(int sock, const JobResult& result);
+bool receiveResult(int sock, JobResult& result);
@@ -0,0 +1,393 @@
+/*
+ * PDTL: Parallel and Distributed Triangle Listing for Massive Graphs
+ * Ilias Giechaskiel, George Panagopoulos, Eiko Yoneki
+ * 44th International Conference on Parallel Processing (ICPP), Beijing 2015
+ * 
+ * DOI: 10.1109/ICPP.2015.46
+ * 
+ * https://github.com/giech/pdtl
+ */
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/mman.h>
+
+#include "reorder.h"
+#include "util.h"
+#include "fileparser.h"
+#include "degreehandler.h"
+#include "graphfile.h"
+
+using namespace std;
+
+#define LP_ROUNDS 5
+
+// Degree offsets in memory, and neighbours mapped from the graph, so
+// that only O(|V|) memory is needed in addition to the page cache
+
+class MappedGraph {
+	public:
+		MappedGraph(const char* input)
+		{
+			DegreeHandler degs(getDegFile(input));
+			size = (vx) degs.getGraphSize();
+			offsets = new unsigned long long[size+1];
+			maxDeg = 0;
+			offsets[0] = 0;
+			vx v;
+			for (v = 0; v < size; ++v)
+			{
+				vx d = degs.getDegree(v);
+				offsets[v+1] = offsets[v] + d;
+				maxDeg = max(maxDeg, d);
+			}
+
+			adj = mapAdjacency(input, edges);
+			if (adj != NULL)
+			{
+				madvise(adj, edges*sizeof(vx), MADV_RANDOM);
+			}
+		}
+
+		~MappedGraph()
+		{
+			unmapAdjacency(adj, edges);
+			delete[] offsets;
+		}
+
+		inline vx degree(vx v) const
+		{
+			return (vx) (offsets[v+1] - offsets[v]);
+		}
+
+		inline const vx* neighbors(vx v) const
+		{
+			return adj + offsets[v];
+		}
+
+		vx size;
+		vx maxDeg;
+
+	private:
+		unsigned long long* offsets;
+		vx* adj;
+		unsigned long long edges;
+};
+
+// orders by (degree, id), used for the start vertices and neighbours of RCM
+class DegreeLess {
+	public:
+		DegreeLess(const MappedGraph& graph) : g(graph) {}
+		bool operator()(vx a, vx b) const
+		{
+			vx da = g.degree(a);
+			vx db = g.degree(b);
+			return da < db || (da == db && a < b);
+		}
+
+	private:
+		const MappedGraph& g;
+};
+
+// Stable counting sort of all vertices by key, where key[v] <= maxKey
+static void countingOrder(const vx* key, vx size, vx maxKey, vx* order)
+{
+	unsigned long long* bucket = new unsigned long long[(size_t) maxKey + 2];
+	fill(bucket, bucket + maxKey + 2, 0);
+	vx v;
+	for (v = 0; v < size; ++v)
+	{
+		++bucket[key[v]+1];
+	}
+	for (v = 0; v <= maxKey; ++v)
+	{
+		bucket[v+1] += bucket[v];
+	}
+	for (v = 0; v < size; ++v)
+	{
+		order[bucket[key[v]]++] = v;
+	}
+	delete[] bucket;
+}
+
+// Breadth-first order, started from every unvisited vertex in id order. With
+// reverse set, this is Reverse Cuthill-McKee instead: components start from
+// a vertex of minimum degree, neighbours are queued by increasing degree,
+// and the final order is reversed.
+void reorderBFS(const char* input, const char* output, bool reverse)
+{
+	MappedGraph g(input);
+	vx* map = new vx[g.size];
+	vx* starts = new vx[g.size];
+	bool* visited = new bool[g.size];
+	vx* list = new vx[g.maxDeg];
+	DegreeLess less(g);
+	fill(visited, visited + g.size, false);
+
+	vx v;
+	if (reverse)
+	{
+		vx* degree = new vx[g.size];
+		for (v = 0; v < g.size; ++v)
+		{
+			degree[v] = g.degree(v);
+		}
+		countingOrder(degree, g.size, g.maxDeg, starts);
+		delete[] degree;
+	}
+	else
+	{
+		for (v = 0; v < g.size; ++v)
+		{
+			starts[v] = v;
+		}
+	}
+
+	// map doubles as the queue
+	vx head = 0;
+	vx tail = 0;
+	for (v = 0; v < g.size; ++v)
+	{
+		vx s = starts[v];
+		if (visited[s])
+		{
+			continue;
+		}
+		visited[s] = true;
+		map[tail++] = s;
+
+		while (head < tail)
+		{
+			vx u = map[head++];
+			vx d = g.degree(u);
+			const vx* adj = g.neighbors(u);
+			vx size = 0;
+			vx j;
+			for (j = 0; j < d; ++j)
+			{
+				vx w = adj[j];
+				if (!visited[w])
+				{
+					visited[w] = true;
+					list[size++] = w;
+				}
+			}
+
+			if (reverse)
+			{
+				sort(list, list + size, less);
+			}
+			for (j = 0; j < size; ++j)
+			{
+				map[tail++] = list[j];
+			}
+		}
+	}
+
+	if (reverse)
+	{
+		std::reverse(map, map + g.size);
+	}
+
+	delete[] list;
+	delete[] visited;
+	delete[] starts;
+	permute(input, output, map);
+	delete[] map;
+}
+
+// Decreasing degree, so that the hubs, which are touched by most
+// intersections, share the first pages of the window
+void reorderDegree(const char* input, const char* output)
+{
+	MappedGraph g(input);
+	vx* key = new vx[g.size];
+	vx* map = new vx[g.size];
+	vx v;
+	for (v = 0; v < g.size; ++v)
+	{
+		key[v] = g.maxDeg - g.degree(v);
+	}
+	countingOrder(key, g.size, g.maxDeg, map);
+	delete[] key;
+
+	permute(input, output, map);
+	delete[] map;
+}
+
+// Approximates community orderings such as Rabbit Order and Gorder with a
+// few rounds of label propagation: each vertex takes the most frequent
+// label among its neighbours, and communities are then laid out
+// contiguously, each in id order.
+void reorderCommunity(const char* input, const char* output)
+{
+	MappedGraph g(input);
+	vx* labels = new vx[g.size];
+	vx* list = new vx[g.maxDeg];
+	vx v;
+	for (v = 0; v < g.size; ++v)
+	{
+		labels[v] = v;
+	}
+
+	unsigned round;
+	for (round = 0; round < LP_ROUNDS; ++round)
+	{
+		unsigned long long changed = 0;
+		for (v = 0; v < g.size; ++v)
+		{
+			vx d = g.degree(v);
+			if (d == 0)
+			{
+				continue;
+			}
+
+			const vx* adj = g.neighbors(v);
+			vx j;
+			for (j = 0; j < d; ++j)
+			{
+				list[j] = labels[adj[j]];
+			}
+			sort(list, list + d);
+
+			// most frequent label, ties going to the smallest
+			vx best = list[0];
+			vx bestCount = 0;
+			vx run = 0;
+			for (j = 0; j < d; ++j)
+			{
+				run = (j > 0 && list[j] == list[j-1]) ? run + 1 : 1;
+				if (run > bestCount)
+				{
+					best = list[j];
+					bestCount = run;
+				}
+			}
+
+			if (best != labels[v])
+			{
+				labels[v] = best;
+				++changed;
+			}
+		}
+
+		cout << "Label propagation round " << round << " changed " << changed << endl;
+		if (changed == 0)
+		{
+			break;
+		}
+	}
+	delete[] list;
+
+	vx* map = new vx[g.size];
+	countingOrder(labels, g.size, g.size > 0 ? g.size - 1 : 0, map);
+	delete[] labels;
+
+	permute(input, output, map);
+	delete[] map;
+}
+
+// Semi-external k-core peeling (Batagelj and Zaversnik): repeatedly removes
+// a vertex of minimum remaining degree, with the vertices kept in buckets
+// by degree. Stores the removal position of each vertex in order, so that
+// orienting from earlier to later positions bounds the out-degree by the
+// degeneracy, which is returned.
+vx degeneracyOrder(const char* input, vx* order)
+{
+	MappedGraph g(input);
+	vx* degree = new vx[g.size];
+	vx* vert = new vx[g.size];
+	vx* pos = order; // positions in vert, final once a vertex is removed
+	unsigned long long* bin = new unsigned long long[(size_t) g.maxDeg + 1];
+	fill(bin, bin + g.maxDeg + 1, 0);
+
+	vx v;
+	for (v = 0; v < g.size; ++v)
+	{
+		degree[v] = g.degree(v);
+		++bin[degree[v]];
+	}
+
+	unsigned long long start = 0;
+	for (v = 0; v <= g.maxDeg; ++v)
+	{
+		unsigned long long num = bin[v];
+		bin[v] = start;
+		start += num;
+	}
+
+	for (v = 0; v < g.size; ++v)
+	{
+		pos[v] = (vx) bin[degree[v]]++;
+		vert[pos[v]] = v;
+	}
+
+	for (v = g.maxDeg; v > 0; --v)
+	{
+		bin[v] = bin[v-1];
+	}
+	bin[0] = 0;
+
+	vx degeneracy = 0;
+	vx i;
+	for (i = 0; i < g.size; ++i)
+	{
+		v = vert[i];
+		degeneracy = max(degeneracy, degree[v]);
+		vx d = g.degree(v);
+		const vx* adj = g.neighbors(v);
+		vx j;
+		for (j = 0; j < d; ++j)
+		{
+			vx u = adj[j];
+			if (degree[u] > degree[v])
+			{
+				// move u to the front of its bucket, then shrink the bucket
+				vx du = degree[u];
+				vx pu = pos[u];
+				vx pw = (vx) bin[du];
+				vx w = vert[pw];
+				if (u != w)
+				{
+					pos[u] = pw;
+					vert[pu] = w;
+					pos[w] = pu;
+					vert[pw] = u;
+				}
+				++bin[du];
+				--degree[u];
+			}
+		}
+	}
+
+	delete[] bin;
+	delete[] vert;
+	delete[] degree;
+	return degeneracy;
+}
+
+bool reorder(const char* input, const char* output, const char* method)
+{
+	if (!strcmp(method, "bfs"))
+	{
+		reorderBFS(input, output);
+	}
+	else if (!strcmp(method, "rcm"))
+	{
+		reorderBFS(input, output, true);
+	}
+	else if (!strcmp(method, "degree"))
+	{
+		reorderDegree(input, output);
+	}
+	else if (!strcmp(method, "community"))
+	{
+		reorderCommunity(input, output);
+	}
+	else
+	{
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,22 @@
+/*
+ * PDTL: Parallel and Distributed Triangle Listing for Massive Graphs
+ * Ilias Giechaskiel, George Panagopoulos, Eiko Yoneki
+ * 44th International Conference on Parallel Processing (ICPP), Beijing 2015
+ * 
+ * DOI: 10.1109/ICPP.2015.46
+ * 
+ * https://github.com/giech/pdtl
+ */
+
+#pragma once
+
+#include "util.h"
+
+// Locality-improving vertex orderings. Each one rewrites the graph through
+// permute(), storing the permutation in the .map file of the output.
+
+bool reorder(const char* input, const char* output, const char* method);
+void reorderBFS(const char* input, const char* output, bool reverse = false);
+void reorderDegree(const char* input, const char* output);
+void reorderCommunity(const char* input, const char* output);
+vx degeneracyOrder(const char* input, vx* order);
@@ -0,0 +1,74 @@
+/*
+ * PDTL: Parallel and Distributed Triangle Listing for Massive Graphs
+ * Ilias Giechaskiel, George Panagopoulos, Eiko Yoneki
+ * 44th International Conference on Parallel Processing (ICPP), Beijing 2015
+ * 
+ * DOI: 10.1109/ICPP.2015.46
+ * 
+ * https://github.com/giech/pdtl
+ */
+
+#include "scheduler.h"
+
+#include <cstdlib>
+#include <thread>
+#include <unistd.h>
+
+using namespace std;
+
+JobScheduler::JobScheduler()
+: running(0), nextTicket(0), serving(0)
+{
+	cores = max(thread::hardware_concurrency(), 1U);
+	memory = (unsigned long long) sysconf(_SC_PHYS_PAGES)*sysconf(_SC_PAGESIZE) >> 20;
+
+	const char* c = getenv("PDTL_CORES");
+	if (c != NULL && atoi(c) > 0)
+	{
+		cores = min(cores, (unsigned) atoi(c));
+	}
+	const char* m = getenv("PDTL_MEMORY");
+	if (m != NULL && atoll(m) > 0)
+	{
+		memory = min(memory, (unsigned long long) atoll(m));
+	}
+	freeCores = cores;
+	freeMemory = memory;
+	cout << "Running jobs on up to " << cores << " cores and " << memory << "MB" << endl;
+}
+
+JobGrant JobScheduler::admit(unsigned threads, unsigned long long mem)
+{
+	JobGrant grant;
+	grant.threads = max(min(threads, cores), 1U);
+	grant.mem = min(mem, memory);
+
+	unique_lock<mutex> lock(mtx);
+	unsigned long long ticket = nextTicket++;
+	while (ticket != serving || grant.threads > freeCores || grant.mem > freeMemory)
+	{
+		freed.wait(lock);
+	}
+	++serving;
+	freeCores -= grant.threads;
+	freeMemory -= grant.mem;
+	++running;
+	// the next job in line may fit in what is left
+	freed.notify_all();
+	return grant;
+}
+
+void JobScheduler::release(const JobGrant& grant)
+{
+	lock_guard<mutex> lock(mtx);
+	freeCores += grant.threads;
+	freeMemory += grant.mem;
+	--running;
+	freed.notify_all();
+}
+
+unsigned JobScheduler::getRunning()
+{
+	lock_guard<mutex> lock(mtx);
+	return running;
+}
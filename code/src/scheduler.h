@@ -0,0 +1,50 @@
+/*
+ * PDTL: Parallel and Distributed Triangle Listing for Massive Graphs
+ * Ilias Giechaskiel, George Panagopoulos, Eiko Yoneki
+ * 44th International Conference on Parallel Processing (ICPP), Beijing 2015
+ * 
+ * DOI: 10.1109/ICPP.2015.46
+ * 
+ * https://github.com/giech/pdtl
+ */
+
+#pragma once
+
+#include "util.h"
+
+#include <mutex>
+#include <condition_variable>
+
+// Admits the jobs of a client against the cores and memory of the machine,
+// PDTL_CORES cores and PDTL_MEMORY megabytes unless set lower than the
+// machine has. Jobs are admitted in the order they ask, each once there
+// are enough cores and memory free for it, so that a large job is not
+// overtaken indefinitely by smaller ones. A job asking for more than the
+// limits is cut down to them, and runs alone.
+
+struct JobGrant {
+	unsigned threads;
+	unsigned long long mem; // in MB
+};
+
+class JobScheduler {
+	public:
+		JobScheduler();
+		// blocks until the job may run
+		JobGrant admit(unsigned threads, unsigned long long mem);
+		void release(const JobGrant& grant);
+		// jobs admitted and not yet released
+		unsigned getRunning();
+		inline unsigned getCores() const { return cores; }
+
+	private:
+		std::mutex mtx;
+		std::condition_variable freed;
+		unsigned cores;
+		unsigned long long memory;
+		unsigned freeCores;
+		unsigned long long freeMemory;
+		unsigned running;
+		unsigned long long nextTicket;
+		unsigned long long serving; // the ticket of the next job to admit
+};
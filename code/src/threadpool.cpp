@@ -18,53 +18,197 @@
 #include "threadpool.h"
 #include "networkutil.h"
 
+using namespace std;
+
+RangeDeque::RangeDeque()
+{
+	top = 0;
+	bottom = 0;
+	unsigned i;
+	for (i = 0; i < STEAL_CAPACITY; ++i)
+		items[i] = NULL;
+}
+
+bool RangeDeque::push(EdgeRange* r)
+{
+	long long b = bottom.load(memory_order_relaxed);
+	long long t = top.load(memory_order_acquire);
+	if (b - t >= STEAL_CAPACITY)
+		return false;
+	items[b % STEAL_CAPACITY].store(r, memory_order_relaxed);
+	atomic_thread_fence(memory_order_release);
+	bottom.store(b + 1, memory_order_relaxed);
+	return true;
+}
+
+EdgeRange* RangeDeque::pop()
+{
+	long long b = bottom.load(memory_order_relaxed) - 1;
+	bottom.store(b, memory_order_relaxed);
+	atomic_thread_fence(memory_order_seq_cst);
+	long long t = top.load(memory_order_relaxed);
+	EdgeRange* r = NULL;
+	if (t <= b)
+	{
+		r = items[b % STEAL_CAPACITY].load(memory_order_relaxed);
+		if (t == b)
+		{
+			// last one, race the thieves for it
+			if (!top.compare_exchange_strong(t, t + 1, memory_order_seq_cst, 
+			                                 memory_order_relaxed))
+				r = NULL;
+			bottom.store(b + 1, memory_order_relaxed);
+		}
+	}
+	else
+	{
+		bottom.store(b + 1, memory_order_relaxed);
+	}
+	return r;
+}
+
+EdgeRange* RangeDeque::steal()
+{
+	long long t = top.load(memory_order_acquire);
+	atomic_thread_fence(memory_order_seq_cst);
+	long long b = bottom.load(memory_order_acquire);
+	if (t >= b)
+		return NULL;
+	EdgeRange* r = items[t % STEAL_CAPACITY].load(memory_order_relaxed);
+	if (!top.compare_exchange_strong(t, t + 1, memory_order_seq_cst, 
+	                                 memory_order_relaxed))
+		return NULL;
+	return r;
+}
+
 ThreadPool::ThreadPool(bool outputb, const ThreadInfo& threadinfo)
-: output(outputb), info(threadinfo) 
+: output(outputb), info(threadinfo), placement(threadinfo.getthreads()),
+  governor((unsigned long long) threadinfo.getmem()*threadinfo.getthreads(), threadinfo.getthreads())
 {
-	chunk = 0;
 	count = 0;
 	instances = info.getthreads();
-	threads = new std::thread[instances];
+	unsigned size = info.getsize();
+	pending = size;
+	idle = 0;
+	parts = size;
+	deques = new RangeDeque[instances];
+
+	// deal the chunks out in turn, last first so that each thread pops its
+	// chunks in order and thieves take the ones at the end
 	unsigned i;
+	for(i = size; i-- > 0; )
+	{
+		EdgeRange* r = new EdgeRange;
+		r->low = info.getchunks()[i];
+		r->high = info.getchunks()[i+1];
+		r->chunk = i;
+		r->part = i;
+		if (!deques[i % instances].push(r))
+		{
+			cerr << "Too many chunks for " << instances << " threads" << endl;
+			exit(1);
+		}
+	}
+
+	threads = new std::thread[instances];
 	for(i = 0; i < instances; i++)
-		threads[i] = std::thread(&ThreadPool::execute, this);
+		threads[i] = std::thread(&ThreadPool::execute, this, i);
 	for(i = 0; i < instances; i++)
 		threads[i].join();
 	delete[] threads;
 }
 
-void ThreadPool::execute(void)
+ThreadPool::~ThreadPool()
 {
-	unsigned long long localcount = 0;
-	unsigned long long index, size = info.getsize();
-	while(true)
+	delete[] deques;
+}
+
+unsigned long long ThreadPool::Worker::split(unsigned long long next, 
+                                             unsigned long long high)
+{
+	if (pool->idle.load() == 0 || high - next < STEAL_MIN_EDGES)
+		return high;
+
+	unsigned long long mid = next + (high - next)/2;
+	EdgeRange* r = new EdgeRange;
+	r->low = mid;
+	r->high = high;
+	r->chunk = current->chunk;
+	r->part = pool->parts++;
+	++pool->pending;
+	if (!pool->deques[id].push(r))
 	{
-		chunk_mtx.lock();
-		if(chunk == size) {
-			chunk_mtx.unlock();
-			break;
-		}
-		index = chunk;
-		chunk++;
-		chunk_mtx.unlock();
-		unsigned long long low = info.getchunks()[index];
-		unsigned long long high = info.getchunks()[index+1];
-		size_t mem = ((unsigned long long)(info.getmem()))*size
-			*(high-low)/
-			info.getgraphsize(); // split memory according to number of edges
-		MGTAdjacencyHandler *handler = 
-			new MGTAdjacencyHandler(info.getinput(),
-					info.getmaxDeg(),
-					mem,
-					output ? getName(getOutName(info.getinput()), index).c_str() : NULL,
-					info.getavdegree()[index]);
-		handler->timedProcessAdjacency(low, high);
-		localcount += handler->getTriangleCount();
-		delete handler;
+		--pool->pending;
+		delete r;
+		return high;
 	}
+	current->high = mid;
+	return mid;
+}
+
+void ThreadPool::run(Worker& worker, EdgeRange* range)
+{
+	unsigned long long low = range->low;
+	unsigned long long high = range->high;
+	size_t mem = ((unsigned long long)(info.getmem()))*info.getsize()
+		*(high-low)/
+		info.getgraphsize(); // split memory according to number of edges
+	mem = placement.limitMemory(worker.id, mem);
+	MGTAdjacencyHandler *handler = 
+		new MGTAdjacencyHandler(info.getinput(),
+				info.getmaxDeg(),
+				mem,
+				output ? getName(getOutName(info.getinput()), range->part).c_str() : NULL,
+				info.getavdegree()[range->chunk],
+				DEFAULT_BUF,
+				&worker.arena);
+	worker.current = range;
+	handler->setSplitter(&worker);
+	handler->setGovernor(&governor);
+	handler->timedProcessAdjacency(low, high);
 	count_mtx.lock();
-	count += localcount;
+	count += handler->getTriangleCount();
+	profiles.push_back(handler->getProfile());
 	count_mtx.unlock();
+	delete handler;
+	delete range;
+	--pending;
+}
+
+EdgeRange* ThreadPool::steal(unsigned id)
+{
+	unsigned i;
+	for (i = 1; i < instances; ++i)
+	{
+		EdgeRange* r = deques[(id + i) % instances].steal();
+		if (r != NULL)
+			return r;
+	}
+	return NULL;
+}
+
+void ThreadPool::execute(unsigned id)
+{
+	// the handlers allocated below are then first touched on this node
+	placement.pin(id);
+	Worker worker;
+	worker.pool = this;
+	worker.id = id;
+	while(true)
+	{
+		EdgeRange* range = deques[id].pop();
+		if (range == NULL)
+		{
+			++idle;
+			while ((range = steal(id)) == NULL && pending.load() > 0)
+				this_thread::sleep_for(chrono::microseconds(STEAL_WAIT));
+			--idle;
+			if (range == NULL)
+				break;
+		}
+		run(worker, range);
+	}
+	governor.retire(&worker.arena);
 }
 
 unsigned long long ThreadPool::getcount(void)
@@ -72,3 +216,12 @@ unsigned long long ThreadPool::getcount(void)
 	return count;
 }
 
+unsigned ThreadPool::getparts(void)
+{
+	return parts;
+}
+
+const vector<RangeProfile>& ThreadPool::getprofiles(void)
+{
+	return profiles;
+}
@@ -19,24 +19,80 @@
 #include "fileparser.h"
 #include "mgt.h"
 #include "loadbalance.h"
+#include "placement.h"
 #include <mutex>
 #include <thread>
+#include <atomic>
+
+#define STEAL_CAPACITY 1024
+#define STEAL_MIN_EDGES 2
+#define STEAL_WAIT 200 // microseconds between attempts to steal
+
+// a range of edges, and the chunk it came from
+struct EdgeRange
+{
+	unsigned long long low;
+	unsigned long long high;
+	unsigned chunk; // for the average degree
+	unsigned part;  // for the output file
+};
+
+// Chase-Lev deque of ranges: the owning thread pushes and pops at the
+// bottom, while other threads steal from the top, without locks
+
+class RangeDeque
+{
+	public:
+		RangeDeque();
+		bool push(EdgeRange* r);
+		EdgeRange* pop();
+		EdgeRange* steal();
+
+	private:
+		std::atomic<long long> top;
+		std::atomic<long long> bottom;
+		std::atomic<EdgeRange*> items[STEAL_CAPACITY];
+};
+
+// Each thread runs the ranges on its own deque, splitting the one it is
+// processing between phases while other threads are idle, and steals from
+// the other deques once its own is empty
 
 class ThreadPool
 {
 	public:
 		ThreadPool(bool outputb, const ThreadInfo& threadinfo);
+		~ThreadPool();
 		unsigned long long getcount(void);
+		unsigned getparts(void); // number of output files
+		const std::vector<RangeProfile>& getprofiles(void);
 
 	private:
-		void execute(void);
+		class Worker : public RangeSplitter
+		{
+			public:
+				ThreadPool* pool;
+				unsigned id;
+				virtual unsigned long long split(unsigned long long next, 
+				                                 unsigned long long high);
+				EdgeRange* current;
+				WindowArena arena;
+		};
+
+		void execute(unsigned id);
+		void run(Worker& worker, EdgeRange* range);
+		EdgeRange* steal(unsigned id);
 		unsigned instances;
 		bool output;
 		const ThreadInfo& info;
-		std::mutex chunk_mtx;
-		unsigned chunk;
+		Placement placement;
+		MemoryGovernor governor;
+		RangeDeque* deques;
+		std::atomic<unsigned long long> pending; // ranges not yet finished
+		std::atomic<unsigned> idle;
+		std::atomic<unsigned> parts;
 		std::mutex count_mtx;
 		unsigned long long count;
+		std::vector<RangeProfile> profiles;
 		std::thread *threads;
 };
-
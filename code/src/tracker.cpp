@@ -0,0 +1,234 @@
+/*
+ * PDTL: Parallel and Distributed Triangle Listing for Massive Graphs
+ * Ilias Giechaskiel, George Panagopoulos, Eiko Yoneki
+ * 44th International Conference on Parallel Processing (ICPP), Beijing 2015
+ * 
+ * DOI: 10.1109/ICPP.2015.46
+ * 
+ * https://github.com/giech/pdtl
+ */
+
+#include "tracker.h"
+
+#include <stdlib.h>
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+using namespace std;
+
+ChunkTracker::ChunkTracker(unsigned count, unsigned machines)
+: chunks(count), queues(machines), running(machines), failed(machines, false),
+  left(count), alive(machines), triangles(0), doneTime(0),
+  secondCopies(0)
+{
+	unsigned i;
+	for (i = 0; i < count; ++i)
+	{
+		chunks[i].done = false;
+		chunks[i].copies = 0;
+		chunks[i].started = 0;
+	}
+	timer.start();
+}
+
+void ChunkTracker::assign(unsigned machine, unsigned first, unsigned count)
+{
+	lock_guard<mutex> lock(mtx);
+	unsigned i;
+	for (i = first; i < first + count; ++i)
+	{
+		queues[machine].push_back(i);
+	}
+}
+
+// starts a copy of the chunk on the machine, unless it is done
+bool ChunkTracker::take(unsigned machine, unsigned c)
+{
+	if (chunks[c].done)
+	{
+		return false;
+	}
+	if (chunks[c].copies == 0)
+	{
+		chunks[c].started = timer.total();
+	}
+	++chunks[c].copies;
+	running[machine].push_back(c);
+	return true;
+}
+
+// the other machine with the most chunks queued, if any has
+int ChunkTracker::victim(unsigned machine)
+{
+	int best = -1;
+	size_t m;
+	for (m = 0; m < queues.size(); ++m)
+	{
+		if (m != machine && !queues[m].empty() &&
+		    (best < 0 || queues[m].size() > queues[best].size()))
+		{
+			best = (int) m;
+		}
+	}
+	return best;
+}
+
+// the chunk running longest past its expected time on another machine, if
+// any has gone on for long enough, and has no second copy yet
+int ChunkTracker::straggler(unsigned machine)
+{
+	unsigned done = (unsigned) chunks.size() - left;
+	if (done == 0)
+	{
+		return -1;
+	}
+	double now = timer.total();
+	double limit = STRAGGLER_FACTOR*doneTime/done;
+	int best = -1;
+	size_t c;
+	for (c = 0; c < chunks.size(); ++c)
+	{
+		if (chunks[c].done || chunks[c].copies != 1 ||
+		    find(running[machine].begin(), running[machine].end(), c) != running[machine].end())
+		{
+			continue;
+		}
+		if (now - chunks[c].started > limit && 
+		    (best < 0 || chunks[c].started < chunks[best].started))
+		{
+			best = (int) c;
+		}
+	}
+	return best;
+}
+
+bool ChunkTracker::next(unsigned machine, unsigned most, vector<unsigned>& batch, 
+                        bool wait)
+{
+	unique_lock<mutex> lock(mtx);
+	batch.clear();
+	while (left > 0 && !failed[machine])
+	{
+		while (batch.size() < most && !queues[machine].empty())
+		{
+			unsigned c = queues[machine].front();
+			queues[machine].pop_front();
+			if (take(machine, c))
+				batch.push_back(c);
+		}
+		while (batch.size() < most && !orphans.empty())
+		{
+			unsigned c = orphans.front();
+			orphans.pop_front();
+			if (take(machine, c))
+				batch.push_back(c);
+		}
+		// the end of another queue is the furthest from where its machine is
+		int v;
+		while (batch.size() < most && (v = victim(machine)) >= 0)
+		{
+			unsigned c = queues[v].back();
+			queues[v].pop_back();
+			if (take(machine, c))
+				batch.push_back(c);
+		}
+		if (batch.empty())
+		{
+			int c = straggler(machine);
+			if (c >= 0)
+			{
+				++secondCopies;
+				take(machine, (unsigned) c);
+				batch.push_back((unsigned) c);
+			}
+		}
+		if (!batch.empty() || !wait)
+		{
+			return true;
+		}
+		changed.wait_for(lock, chrono::duration<double>(STRAGGLER_POLL));
+	}
+	return false;
+}
+
+bool ChunkTracker::complete(unsigned machine, unsigned c, unsigned long long tri)
+{
+	lock_guard<mutex> lock(mtx);
+	vector<unsigned>& r = running[machine];
+	vector<unsigned>::iterator it = find(r.begin(), r.end(), c);
+	if (it == r.end())
+	{
+		return false; // not given to the machine, or given up on it
+	}
+	r.erase(it);
+	--chunks[c].copies;
+	if (chunks[c].done)
+	{
+		return false;
+	}
+
+	chunks[c].done = true;
+	--left;
+	triangles += tri;
+	doneTime += timer.total() - chunks[c].started;
+	changed.notify_all();
+	return true;
+}
+
+void ChunkTracker::fail(unsigned machine)
+{
+	lock_guard<mutex> lock(mtx);
+	if (failed[machine])
+	{
+		return;
+	}
+	failed[machine] = true;
+	--alive;
+
+	orphans.insert(orphans.end(), queues[machine].begin(), queues[machine].end());
+	queues[machine].clear();
+	size_t i;
+	for (i = 0; i < running[machine].size(); ++i)
+	{
+		unsigned c = running[machine][i];
+		if (--chunks[c].copies == 0 && !chunks[c].done)
+		{
+			orphans.push_back(c);
+		}
+	}
+	running[machine].clear();
+	changed.notify_all();
+}
+
+bool ChunkTracker::waitAll()
+{
+	unique_lock<mutex> lock(mtx);
+	while (left > 0 && alive > 0)
+	{
+		changed.wait(lock);
+	}
+	return left == 0;
+}
+
+unsigned long long ChunkTracker::getTriangles()
+{
+	lock_guard<mutex> lock(mtx);
+	return triangles;
+}
+
+unsigned ChunkTracker::getSecondCopies()
+{
+	lock_guard<mutex> lock(mtx);
+	return secondCopies;
+}
+
+unsigned chunkGrain()
+{
+	const char* g = getenv("PDTL_GRAIN");
+	if (g != NULL && atoi(g) > 0)
+	{
+		return (unsigned) atoi(g);
+	}
+	return CHUNK_GRAIN;
+}
@@ -0,0 +1,79 @@
+/*
+ * PDTL: Parallel and Distributed Triangle Listing for Massive Graphs
+ * Ilias Giechaskiel, George Panagopoulos, Eiko Yoneki
+ * 44th International Conference on Parallel Processing (ICPP), Beijing 2015
+ * 
+ * DOI: 10.1109/ICPP.2015.46
+ * 
+ * https://github.com/giech/pdtl
+ */
+
+#pragma once
+
+#include "util.h"
+
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <vector>
+
+#define STRAGGLER_FACTOR 1.5
+#define STRAGGLER_POLL 0.05 // seconds
+#define CHUNK_GRAIN 4 // chunks per thread, unless PDTL_GRAIN is set
+
+// Tracks the chunks of a distributed run, and which machines run them. The
+// chunks are queued per machine, and machines ask for them as their threads
+// become idle. A machine that runs out of its own chunks takes over those
+// left by machines that failed, then steals from the back of the longest
+// queue of another machine, and then runs a second copy of a chunk that has
+// been running STRAGGLER_FACTOR times as long as chunks have taken on
+// average. Only the first result of a chunk counts.
+
+class ChunkTracker {
+	public:
+		ChunkTracker(unsigned chunks, unsigned machines);
+		// chunks [first, first + count) are for the machine
+		void assign(unsigned machine, unsigned first, unsigned count);
+		// blocks until there are chunks for the machine to run, at most the
+		// given number of them, and returns false once all chunks are done;
+		// without waiting, the batch may come back empty
+		bool next(unsigned machine, unsigned most, std::vector<unsigned>& batch,
+		          bool wait = true);
+		// true if this is the first result for the chunk, which then counts
+		bool complete(unsigned machine, unsigned chunk, unsigned long long triangles);
+		// the chunks the machine had left, or was running, go to the others
+		void fail(unsigned machine);
+		// false if the machines failed before all chunks were done
+		bool waitAll();
+		unsigned long long getTriangles();
+		// of stragglers, run by the time all chunks were done
+		unsigned getSecondCopies();
+
+	private:
+		struct Chunk {
+			bool done;
+			unsigned copies; // running
+			double started;
+		};
+
+		std::mutex mtx;
+		std::condition_variable changed;
+		std::vector<Chunk> chunks;
+		std::vector<std::deque<unsigned> > queues; // per machine
+		std::vector<std::vector<unsigned> > running; // per machine
+		std::vector<bool> failed;
+		std::deque<unsigned> orphans; // of failed machines
+		unsigned left;
+		unsigned alive;
+		unsigned long long triangles;
+		double doneTime; // of the chunks done, from their first start
+		unsigned secondCopies;
+		Timer timer;
+
+		bool take(unsigned machine, unsigned chunk);
+		int victim(unsigned machine);
+		int straggler(unsigned machine);
+};
+
+// chunks to cut per thread of the run
+unsigned chunkGrain();
@@ -51,6 +51,27 @@ string getOutName(const char* base)
 	return a + b;
 }
 
+string getMapName(const char* base)
+{
+	string a(base);
+	string b(".map");
+	return a + b;
+}
+
+string getProfileName(const char* base)
+{
+	string a(base);
+	string b(".profile");
+	return a + b;
+}
+
+string getKeyName(const char* base)
+{
+	string a(base);
+	string b(".key");
+	return a + b;
+}
+
 size_t getFileSize(const char* file)
 {
 	struct stat filestatus;
@@ -43,6 +43,9 @@ typedef unsigned int vx;
 std::string getAdjName(const char* base);
 std::string getDegName(const char* base);
 std::string getOutName(const char* base);
+std::string getMapName(const char* base);
+std::string getProfileName(const char* base);
+std::string getKeyName(const char* base);
 
 size_t getFileSize(const char* file);
 